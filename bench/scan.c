@@ -0,0 +1,146 @@
+// Compares finding lines with scanLine against reading them with getLine
+// and scanning each one, the way files were loaded before the scanner.
+//
+// Usage: bench [megabytes]
+// The text is generated from a fixed seed, so every run reads the same lines.
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "scan.h"
+#include "terminal.h"
+#include "utils.h"
+
+#define BENCH_RUNS 5
+
+// utils.c panics through the terminal, there is none here
+void terminalExit(void) {}
+
+typedef struct BenchResult {
+  int64_t lines;
+  int64_t plain;
+  double seconds;
+} BenchResult;
+
+static uint32_t seed = 12345;
+
+static uint32_t nextRandom(void) {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+// Mostly ASCII code, with some tabs, UTF-8 and long lines
+static void writeText(FILE* fp, int64_t size) {
+  static const char ascii[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 (){};=+";
+  char line[4096];
+  int64_t written = 0;
+  while (written < size) {
+    uint32_t kind = nextRandom() % 100;
+    int len = (kind < 2) ? 1000 + nextRandom() % 3000 : nextRandom() % 100;
+    for (int i = 0; i < len; i++) {
+      line[i] = ascii[nextRandom() % (sizeof(ascii) - 1)];
+    }
+    if (kind >= 2 && kind < 12 && len > 0) line[0] = '\t';
+    if (kind >= 12 && kind < 15 && len > 1) {
+      line[len - 2] = (char)0xC3;
+      line[len - 1] = (char)0xA9;
+    }
+    line[len++] = '\n';
+    fwrite(line, 1, len, fp);
+    written += len;
+  }
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static BenchResult benchScanLine(FILE* fp, int64_t size) {
+  BenchResult result = {0};
+  double start = now();
+
+  char* buf = malloc_s(size);
+  rewind(fp);
+  if (fread(buf, 1, size, fp) != (size_t)size) PANIC("fread");
+
+  const char* p = buf;
+  const char* end = buf + size;
+  while (p < end) {
+    int flags;
+    const char* nl = scanLine(p, end, &flags);
+    result.lines++;
+    if (!flags) result.plain++;
+    p = (nl < end) ? nl + 1 : end;
+  }
+  free(buf);
+
+  result.seconds = now() - start;
+  return result;
+}
+
+static BenchResult benchGetLine(FILE* fp) {
+  BenchResult result = {0};
+  double start = now();
+
+  char* line = NULL;
+  size_t n = 0;
+  int64_t len;
+  rewind(fp);
+  while ((len = getLine(&line, &n, fp)) != -1) {
+    if (len > 0 && line[len - 1] == '\n') len--;
+    result.lines++;
+    if (!scanText(line, len)) result.plain++;
+  }
+  free(line);
+
+  result.seconds = now() - start;
+  return result;
+}
+
+static void report(const char* name, BenchResult result, int64_t size) {
+  printf("%-10s %10lld lines %8.1f ms %8.1f MB/s\n", name,
+         (long long)result.lines, result.seconds * 1000,
+         size / result.seconds / (1 << 20));
+}
+
+int main(int argc, char* argv[]) {
+  int64_t size = (int64_t)((argc > 1) ? strToInt(argv[1]) : 256) << 20;
+  if (size <= 0) {
+    fprintf(stderr, "Usage: %s [megabytes]\n", argv[0]);
+    return 1;
+  }
+
+  FILE* fp = tmpfile();
+  if (!fp) PANIC("tmpfile");
+  writeText(fp, size);
+  fflush(fp);
+  size = ftell(fp);
+
+  // Best of a few runs, the first one also warms the page cache
+  BenchResult scan = {.seconds = 1e9};
+  BenchResult get = {.seconds = 1e9};
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    BenchResult r = benchScanLine(fp, size);
+    if (r.seconds < scan.seconds) scan = r;
+    r = benchGetLine(fp);
+    if (r.seconds < get.seconds) get = r;
+  }
+  fclose(fp);
+
+  report("scanLine", scan, size);
+  report("getLine", get, size);
+  printf("speedup    %.2fx\n", get.seconds / scan.seconds);
+
+  if (scan.lines != get.lines || scan.plain != get.plain) {
+    fprintf(stderr, "The two ways found different lines!\n");
+    return 1;
+  }
+  return 0;
+}
@@ -1,12 +1,36 @@
 #include "action.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "editor.h"
 #include "terminal.h"
 
+void editorApplyPatch(EditorFile* file, const PatchAction* patch, bool undo) {
+  // From the last hunk, so the rows of the ones before it stay where they are
+  for (int i = patch->count - 1; i >= 0; i--) {
+    const PatchHunk* hunk = &patch->hunks[i];
+    int at = undo ? hunk->new_y : hunk->old_y;
+    const EditorClipboard* from = undo ? &hunk->new_lines : &hunk->old_lines;
+    const EditorClipboard* to = undo ? &hunk->old_lines : &hunk->new_lines;
+
+    for (size_t j = 0; j < from->size; j++) {
+      editorFreeRow(file, editorGetRow(file, at + j));
+    }
+    EditorRow* rows = malloc_s(sizeof(EditorRow) * (to->size + 1));
+    for (size_t j = 0; j < to->size; j++) {
+      editorInitRow(file, &rows[j], to->data[j], strlen(to->data[j]));
+    }
+    editorSpliceRows(file, at, from->size, rows, to->size);
+    free(rows);
+  }
+  file->lineno_width = getDigit(file->num_rows) + 2;
+}
+
 bool editorUndo(void) {
-  if (current_file->action_current == current_file->action_head) return false;
+  if (current_file->action_current == current_file->action_head &&
+      !editorPageHistory(current_file))
+    return false;
 
   switch (current_file->action_current->action->type) {
     case ACTION_EDIT: {
@@ -14,17 +38,30 @@ bool editorUndo(void) {
       editorDeleteText(edit->added_range);
       editorPasteText(&edit->deleted_text, edit->deleted_range.start_x,
                       edit->deleted_range.start_y);
+      editorJournalEdit(current_file, edit->added_range, &edit->deleted_text,
+                        edit->deleted_range.start_x,
+                        edit->deleted_range.start_y);
       current_file->cursor = edit->old_cursor;
     } break;
 
     case ACTION_ATTRI: {
       AttributeAction* attri = &current_file->action_current->action->attri;
       current_file->newline = attri->old_newline;
+      editorJournalNewline(current_file, attri->old_newline);
+    } break;
+
+    case ACTION_PATCH: {
+      PatchAction* patch = &current_file->action_current->action->patch;
+      editorApplyPatch(current_file, patch, true);
+      current_file->newline = patch->old_newline;
+      editorJournalPatch(current_file, patch, true);
+      current_file->cursor = patch->old_cursor;
     } break;
   }
 
   current_file->action_current = current_file->action_current->prev;
   current_file->dirty--;
+  current_file->revision++;
   return true;
 }
 
@@ -39,27 +76,61 @@ bool editorRedo(void) {
       editorDeleteText(edit->deleted_range);
       editorPasteText(&edit->added_text, edit->added_range.start_x,
                       edit->added_range.start_y);
+      editorJournalEdit(current_file, edit->deleted_range, &edit->added_text,
+                        edit->added_range.start_x, edit->added_range.start_y);
       current_file->cursor = edit->new_cursor;
     } break;
 
     case ACTION_ATTRI: {
       AttributeAction* attri = &current_file->action_current->action->attri;
       current_file->newline = attri->new_newline;
+      editorJournalNewline(current_file, attri->new_newline);
+    } break;
+
+    case ACTION_PATCH: {
+      PatchAction* patch = &current_file->action_current->action->patch;
+      editorApplyPatch(current_file, patch, false);
+      current_file->newline = patch->new_newline;
+      editorJournalPatch(current_file, patch, false);
+      current_file->cursor = patch->new_cursor;
     } break;
   }
 
   current_file->dirty++;
+  current_file->revision++;
   return true;
 }
 
 void editorAppendAction(EditorAction* action) {
   if (!action) return;
 
+  // The change has already been made
+  switch (action->type) {
+    case ACTION_EDIT: {
+      EditAction* edit = &action->edit;
+      editorJournalEdit(current_file, edit->deleted_range, &edit->added_text,
+                        edit->added_range.start_x, edit->added_range.start_y);
+    } break;
+
+    case ACTION_ATTRI:
+      editorJournalNewline(current_file, action->attri.new_newline);
+      break;
+
+    case ACTION_PATCH:
+      editorJournalPatch(current_file, &action->patch, false);
+      break;
+  }
+
+  editorPushAction(action);
+}
+
+void editorPushAction(EditorAction* action) {
   EditorActionList* node = malloc_s(sizeof(EditorActionList));
   node->action = action;
   node->next = NULL;
 
   current_file->dirty++;
+  current_file->revision++;
 
   editorFreeActionList(current_file->action_current->next);
 
@@ -81,6 +152,12 @@ void editorFreeAction(EditorAction* action) {
   if (action->type == ACTION_EDIT) {
     editorFreeClipboardContent(&action->edit.deleted_text);
     editorFreeClipboardContent(&action->edit.added_text);
+  } else if (action->type == ACTION_PATCH) {
+    for (int i = 0; i < action->patch.count; i++) {
+      editorFreeClipboardContent(&action->patch.hunks[i].old_lines);
+      editorFreeClipboardContent(&action->patch.hunks[i].new_lines);
+    }
+    free(action->patch.hunks);
   }
 
   free(action);
@@ -27,9 +27,32 @@ typedef struct AttributeAction {
   int new_newline;
 } AttributeAction;
 
+// Whole rows replaced, old_y is where they start before the patch and
+// new_y after it
+typedef struct PatchHunk {
+  int old_y;
+  int new_y;
+  EditorClipboard old_lines;
+  EditorClipboard new_lines;
+} PatchHunk;
+
+// Rows replaced in several places at once, like a file reloaded from disk.
+// Hunks are in order and applied in one pass over the rows.
+typedef struct PatchAction {
+  int count;
+  PatchHunk* hunks;
+
+  int old_newline;
+  int new_newline;
+
+  EditorCursor old_cursor;
+  EditorCursor new_cursor;
+} PatchAction;
+
 typedef enum EditorActionType {
   ACTION_EDIT,
   ACTION_ATTRI,
+  ACTION_PATCH,
 } EditorActionType;
 
 typedef struct EditorAction {
@@ -37,6 +60,7 @@ typedef struct EditorAction {
   union {
     EditAction edit;
     AttributeAction attri;
+    PatchAction patch;
   };
 } EditorAction;
 
@@ -46,9 +70,17 @@ typedef struct EditorActionList {
   EditorAction* action;
 } EditorActionList;
 
+typedef struct EditorFile EditorFile;
+
+// Replace the rows of every hunk, or put the old ones back with undo
+void editorApplyPatch(EditorFile* file, const PatchAction* patch, bool undo);
+
 bool editorUndo(void);
 bool editorRedo(void);
 void editorAppendAction(EditorAction* action);
+// Same without journaling it, for a change that leaves the buffer the same
+// as the file on disk
+void editorPushAction(EditorAction* action);
 void editorFreeActionList(EditorActionList* thisptr);
 void editorFreeAction(EditorAction* action);
 
@@ -0,0 +1,458 @@
+#include "compress.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "utils.h"
+
+// Output the worker can get ahead of the reader by
+#define DECOMPRESS_BUFFERS 4
+#define DECOMPRESS_BUFFER_SIZE (1 << 20)
+// zlib counts input in 32 bits
+#define GZIP_INPUT_MAX (1 << 30)
+#define COMPRESS_BUFFER_SIZE (1 << 16)
+
+CompressType getCompressType(const char* data, size_t len) {
+  const unsigned char* p = (const unsigned char*)data;
+  if (len >= 2 && p[0] == 0x1F && p[1] == 0x8B) return COMPRESS_GZIP;
+  if (len >= 4 && p[0] == 0x28 && p[1] == 0xB5 && p[2] == 0x2F &&
+      p[3] == 0xFD)
+    return COMPRESS_ZSTD;
+  return COMPRESS_NONE;
+}
+
+bool isCompressSupported(CompressType type) {
+  switch (type) {
+#ifdef HAVE_ZLIB
+    case COMPRESS_GZIP:
+      return true;
+#endif
+#ifdef HAVE_ZSTD
+    case COMPRESS_ZSTD:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+const char* getCompressName(CompressType type) {
+  switch (type) {
+    case COMPRESS_GZIP:
+      return "gzip";
+    case COMPRESS_ZSTD:
+      return "zstd";
+    default:
+      return "";
+  }
+}
+
+// Decompression
+
+struct Decompressor {
+  CompressType type;
+  const char* data;
+  size_t size;
+
+  // Only touched by the worker
+  size_t offset;
+  bool stream_end;
+#ifdef HAVE_ZLIB
+  z_stream gzip;
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_DStream* zstd;
+  ZSTD_inBuffer input;
+#endif
+
+  thrd_t thread;
+  bool threaded;
+  mtx_t mutex;
+  cnd_t cond;
+
+  // Guarded by mutex. Buffers from head to head + count are full, the one at
+  // head is being read if reading is set.
+  int head;
+  int count;
+  bool reading;
+  bool finished;
+  bool error;
+  bool cancel;
+  size_t consumed;
+  size_t lens[DECOMPRESS_BUFFERS];
+
+  char* buffers[DECOMPRESS_BUFFERS];
+};
+
+#ifdef HAVE_ZLIB
+static int64_t gzipStep(Decompressor* d, char* out, size_t len) {
+  z_stream* z = &d->gzip;
+  z->next_out = (Bytef*)out;
+  z->avail_out = len;
+
+  while (z->avail_out) {
+    if (!z->avail_in) {
+      size_t left = d->size - d->offset;
+      if (!left) break;
+      if (left > GZIP_INPUT_MAX) left = GZIP_INPUT_MAX;
+      z->next_in = (Bytef*)(d->data + d->offset);
+      z->avail_in = left;
+      d->offset += left;
+    }
+
+    int ret = inflate(z, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END) {
+      d->stream_end = true;
+      if (!z->avail_in && d->offset == d->size) break;
+      // Members put one after another, like cat a.gz b.gz
+      if (inflateReset(z) != Z_OK) return -1;
+      d->stream_end = false;
+    } else if (ret != Z_OK) {
+      return -1;
+    }
+  }
+  return len - z->avail_out;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static int64_t zstdStep(Decompressor* d, char* out, size_t len) {
+  ZSTD_outBuffer output = {out, len, 0};
+  while (output.pos < output.size) {
+    size_t pos = output.pos;
+    size_t ret = ZSTD_decompressStream(d->zstd, &output, &d->input);
+    if (ZSTD_isError(ret)) return -1;
+    // Frames one after another are read as one stream
+    d->stream_end = (ret == 0);
+    if (d->input.pos == d->input.size && output.pos == pos) break;
+  }
+  return output.pos;
+}
+#endif
+
+// Returns bytes written to out, 0 at the end and -1 on broken data
+static int64_t decompressStep(Decompressor* d, char* out, size_t len,
+                              size_t* consumed) {
+  int64_t n = -1;
+  switch (d->type) {
+#ifdef HAVE_ZLIB
+    case COMPRESS_GZIP:
+      n = gzipStep(d, out, len);
+      *consumed = d->offset - d->gzip.avail_in;
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case COMPRESS_ZSTD:
+      n = zstdStep(d, out, len);
+      *consumed = d->input.pos;
+      break;
+#endif
+    default:
+      UNUSED(out);
+      UNUSED(len);
+      UNUSED(consumed);
+      break;
+  }
+  // Input ran out in the middle of the stream
+  if (n == 0 && !d->stream_end) n = -1;
+  return n;
+}
+
+static int decompressThread(void* arg) {
+  Decompressor* d = arg;
+  while (true) {
+    mtx_lock(&d->mutex);
+    while (!d->cancel && d->count == DECOMPRESS_BUFFERS) {
+      cnd_wait(&d->cond, &d->mutex);
+    }
+    bool cancel = d->cancel;
+    int slot = (d->head + d->count) % DECOMPRESS_BUFFERS;
+    mtx_unlock(&d->mutex);
+    if (cancel) break;
+
+    size_t consumed = 0;
+    int64_t n =
+        decompressStep(d, d->buffers[slot], DECOMPRESS_BUFFER_SIZE, &consumed);
+
+    mtx_lock(&d->mutex);
+    if (n > 0) {
+      d->lens[slot] = n;
+      d->count++;
+    } else {
+      d->finished = true;
+      d->error = (n < 0);
+    }
+    d->consumed = consumed;
+    cnd_broadcast(&d->cond);
+    mtx_unlock(&d->mutex);
+    if (n <= 0) break;
+  }
+  return 0;
+}
+
+static void decompressEnd(Decompressor* d) {
+  switch (d->type) {
+#ifdef HAVE_ZLIB
+    case COMPRESS_GZIP:
+      inflateEnd(&d->gzip);
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case COMPRESS_ZSTD:
+      ZSTD_freeDStream(d->zstd);
+      break;
+#endif
+    default:
+      break;
+  }
+}
+
+Decompressor* decompressStart(CompressType type, const char* data,
+                              size_t size) {
+  if (!isCompressSupported(type)) return NULL;
+
+  Decompressor* d = calloc_s(1, sizeof(Decompressor));
+  d->type = type;
+  d->data = data;
+  d->size = size;
+
+  bool success = false;
+  switch (type) {
+#ifdef HAVE_ZLIB
+    case COMPRESS_GZIP:
+      // Also takes zlib headers
+      success = (inflateInit2(&d->gzip, 15 + 32) == Z_OK);
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case COMPRESS_ZSTD:
+      d->zstd = ZSTD_createDStream();
+      success = d->zstd && !ZSTD_isError(ZSTD_initDStream(d->zstd));
+      if (!success) ZSTD_freeDStream(d->zstd);
+      d->input = (ZSTD_inBuffer){data, size, 0};
+      break;
+#endif
+    default:
+      break;
+  }
+  if (!success) {
+    free(d);
+    return NULL;
+  }
+
+  for (int i = 0; i < DECOMPRESS_BUFFERS; i++) {
+    d->buffers[i] = malloc_s(DECOMPRESS_BUFFER_SIZE);
+  }
+
+  // Without a worker every read decompresses the next buffer itself
+  if (mtx_init(&d->mutex, mtx_plain) == thrd_success) {
+    if (cnd_init(&d->cond) == thrd_success) {
+      d->threaded = (thrd_create(&d->thread, decompressThread, d) ==
+                     thrd_success);
+      if (!d->threaded) cnd_destroy(&d->cond);
+    }
+    if (!d->threaded) mtx_destroy(&d->mutex);
+  }
+  return d;
+}
+
+int64_t decompressRead(Decompressor* d, const char** out) {
+  if (!d->threaded) {
+    if (d->finished) return d->error ? -1 : 0;
+    int64_t n = decompressStep(d, d->buffers[0], DECOMPRESS_BUFFER_SIZE,
+                               &d->consumed);
+    if (n <= 0) {
+      d->finished = true;
+      d->error = (n < 0);
+    }
+    *out = d->buffers[0];
+    return n;
+  }
+
+  mtx_lock(&d->mutex);
+  // The last buffer returned is done with
+  if (d->reading) {
+    d->head = (d->head + 1) % DECOMPRESS_BUFFERS;
+    d->count--;
+    d->reading = false;
+    cnd_broadcast(&d->cond);
+  }
+  while (!d->count && !d->finished) {
+    cnd_wait(&d->cond, &d->mutex);
+  }
+
+  int64_t n;
+  if (d->count) {
+    *out = d->buffers[d->head];
+    n = d->lens[d->head];
+    d->reading = true;
+  } else {
+    n = d->error ? -1 : 0;
+  }
+  mtx_unlock(&d->mutex);
+  return n;
+}
+
+size_t decompressProgress(Decompressor* d) {
+  if (!d->threaded) return d->consumed;
+
+  mtx_lock(&d->mutex);
+  size_t consumed = d->consumed;
+  mtx_unlock(&d->mutex);
+  return consumed;
+}
+
+void decompressFree(Decompressor* d) {
+  if (!d) return;
+
+  if (d->threaded) {
+    mtx_lock(&d->mutex);
+    d->cancel = true;
+    cnd_broadcast(&d->cond);
+    mtx_unlock(&d->mutex);
+    thrd_join(d->thread, NULL);
+    cnd_destroy(&d->cond);
+    mtx_destroy(&d->mutex);
+  }
+
+  decompressEnd(d);
+  for (int i = 0; i < DECOMPRESS_BUFFERS; i++) {
+    free(d->buffers[i]);
+  }
+  free(d);
+}
+
+// Compression
+
+struct Compressor {
+  CompressType type;
+  FILE* fp;
+#ifdef HAVE_ZLIB
+  z_stream gzip;
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_CCtx* zstd;
+#endif
+  char buf[COMPRESS_BUFFER_SIZE];
+};
+
+#ifdef HAVE_ZLIB
+static bool gzipDeflate(Compressor* c, const char* data, size_t len,
+                        int flush) {
+  z_stream* z = &c->gzip;
+  z->next_in = (Bytef*)data;
+  z->avail_in = len;
+
+  int ret;
+  do {
+    z->next_out = (Bytef*)c->buf;
+    z->avail_out = sizeof(c->buf);
+    ret = deflate(z, flush);
+    if (ret == Z_STREAM_ERROR) return false;
+
+    size_t n = sizeof(c->buf) - z->avail_out;
+    if (n && fwrite(c->buf, 1, n, c->fp) != n) return false;
+  } while (z->avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+  return true;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static bool zstdCompress(Compressor* c, const char* data, size_t len,
+                         ZSTD_EndDirective mode) {
+  ZSTD_inBuffer input = {data, len, 0};
+  size_t remaining;
+  do {
+    ZSTD_outBuffer output = {c->buf, sizeof(c->buf), 0};
+    remaining = ZSTD_compressStream2(c->zstd, &output, &input, mode);
+    if (ZSTD_isError(remaining)) return false;
+    if (output.pos && fwrite(c->buf, 1, output.pos, c->fp) != output.pos)
+      return false;
+  } while (mode == ZSTD_e_end ? remaining != 0 : input.pos < input.size);
+  return true;
+}
+#endif
+
+Compressor* compressStart(CompressType type, FILE* fp) {
+  if (!isCompressSupported(type)) return NULL;
+
+  Compressor* c = calloc_s(1, sizeof(Compressor));
+  c->type = type;
+  c->fp = fp;
+
+  bool success = false;
+  switch (type) {
+#ifdef HAVE_ZLIB
+    case COMPRESS_GZIP:
+      success = (deflateInit2(&c->gzip, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                              15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case COMPRESS_ZSTD:
+      c->zstd = ZSTD_createCCtx();
+      success = (c->zstd != NULL);
+      break;
+#endif
+    default:
+      break;
+  }
+  if (!success) {
+    free(c);
+    return NULL;
+  }
+  return c;
+}
+
+bool compressWrite(Compressor* c, const char* data, size_t len) {
+  switch (c->type) {
+#ifdef HAVE_ZLIB
+    case COMPRESS_GZIP:
+      while (len > 0) {
+        size_t n = (len > GZIP_INPUT_MAX) ? GZIP_INPUT_MAX : len;
+        if (!gzipDeflate(c, data, n, Z_NO_FLUSH)) return false;
+        data += n;
+        len -= n;
+      }
+      return true;
+#endif
+#ifdef HAVE_ZSTD
+    case COMPRESS_ZSTD:
+      return zstdCompress(c, data, len, ZSTD_e_continue);
+#endif
+    default:
+      UNUSED(data);
+      UNUSED(len);
+      return false;
+  }
+}
+
+bool compressFinish(Compressor* c) {
+  bool success = false;
+  switch (c->type) {
+#ifdef HAVE_ZLIB
+    case COMPRESS_GZIP:
+      success = gzipDeflate(c, NULL, 0, Z_FINISH);
+      deflateEnd(&c->gzip);
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case COMPRESS_ZSTD:
+      success = zstdCompress(c, NULL, 0, ZSTD_e_end);
+      ZSTD_freeCCtx(c->zstd);
+      break;
+#endif
+    default:
+      break;
+  }
+  free(c);
+  return success;
+}
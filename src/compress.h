@@ -0,0 +1,42 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Compressed files are read and written as streams, without an uncompressed
+// copy on disk. gzip needs zlib and zstd needs libzstd, see the makefile.
+typedef enum CompressType {
+  COMPRESS_NONE = 0,
+  COMPRESS_GZIP,
+  COMPRESS_ZSTD,
+} CompressType;
+
+// Found from the magic bytes
+CompressType getCompressType(const char* data, size_t len);
+bool isCompressSupported(CompressType type);
+const char* getCompressName(CompressType type);
+
+typedef struct Decompressor Decompressor;
+
+// Decompress on its own thread, a few buffers ahead of the reader. data has
+// to stay valid until it's freed.
+Decompressor* decompressStart(CompressType type, const char* data,
+                              size_t size);
+// Next piece of output, valid until the next call. Returns 0 at the end and
+// -1 if the data is broken.
+int64_t decompressRead(Decompressor* d, const char** out);
+// Input bytes used so far
+size_t decompressProgress(Decompressor* d);
+void decompressFree(Decompressor* d);
+
+typedef struct Compressor Compressor;
+
+Compressor* compressStart(CompressType type, FILE* fp);
+bool compressWrite(Compressor* c, const char* data, size_t len);
+// Write the end of the stream and free it
+bool compressFinish(Compressor* c);
+
+#endif
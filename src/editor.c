@@ -41,11 +41,18 @@ void editorInitFile(EditorFile* file) {
 }
 
 void editorFreeFile(EditorFile* file) {
-  for (int i = 0; i < file->num_rows; i++) {
-    editorFreeRow(&file->row[i]);
-  }
+  editorCancelLoad(file);
+  editorWaitSave(file);
+  editorFreePager(file);
+  editorFreeHexView(file);
+  editorFreeJournal(file);
+  editorFreeSessionTab(file);
+  editorFreeHistory(file);
+  if (file->stream) closeInputStream();
+  editorFreeRows(file);
   editorFreeActionList(file->action_head);
-  free(file->row);
+  unmapFile(&file->map);
+  editorFreeAddBuffer(&file->add);
   free(file->filename);
 }
 
@@ -60,6 +67,12 @@ int editorAddFile(EditorFile* file) {
   *current = *file;
   current->action_head = calloc_s(1, sizeof(EditorActionList));
   current->action_current = current->action_head;
+  // Files loading in the background and restored tabs are recovered once
+  // they are loaded
+  if (!current->loader && !current->session) {
+    editorLoadHistory(current);
+    editorRecoverJournal(current);
+  }
 
   editor.file_count++;
   return editor.file_count - 1;
@@ -80,10 +93,28 @@ void editorRemoveFile(int index) {
   editor.file_count--;
 }
 
+// Returns true if anything on screen changed
+bool editorPollBackground(void) {
+  bool updated = false;
+  for (int i = 0; i < editor.file_count; i++) {
+    if (editorPollMap(&editor.files[i])) updated = true;
+    if (editorPollLoad(&editor.files[i])) updated = true;
+    if (editorPollSave(&editor.files[i])) updated = true;
+    if (editorPollPager(&editor.files[i])) updated = true;
+    if (editorPollFollow(&editor.files[i])) updated = true;
+    if (editorPollSession(&editor.files[i])) updated = true;
+    editorPollJournal(&editor.files[i]);
+  }
+  // Only the file on screen is checked for changes
+  if (editor.file_count && editorPollReload(current_file)) updated = true;
+  return updated;
+}
+
 void editorChangeToFile(int index) {
   if (index < 0 || index >= editor.file_count) return;
   editor.file_index = index;
   current_file = &editor.files[index];
+  editorLoadTab(current_file);
 
   if (editor.tab_offset > index ||
       editor.tab_offset + editor.tab_displayed <= index) {
@@ -6,9 +6,17 @@
 #include "action.h"
 #include "config.h"
 #include "file_io.h"
+#include "hexview.h"
+#include "history.h"
+#include "journal.h"
 #include "os.h"
+#include "pager.h"
+#include "piece.h"
+#include "reload.h"
 #include "row.h"
+#include "rowtree.h"
 #include "select.h"
+#include "session.h"
 
 #define EDITOR_FILE_MAX_SLOT 32
 
@@ -37,12 +45,50 @@ typedef struct EditorFile {
 
   // File info
   int dirty;
+  // Goes up with every change, undo and redo, so it never comes back to a
+  // value like dirty can
+  uint64_t revision;
   uint8_t newline;
+  // Compressed and encoded on disk, it's saved the same way
+  uint8_t compress;
+  uint8_t encoding;
   char* filename;
   FileInfo file_info;
+  // What the file on disk was when it was last checked
+  FileStamp disk_stamp;
 
   // Text buffers
-  EditorRow* row;
+  EditorRowTree* rows;
+  FileMap map;
+  EditorAddBuffer add;
+
+  // Rest of the file being loaded in the background
+  EditorLoader* loader;
+
+  // Save running in the background
+  EditorSaver* saver;
+
+  // Read-only window into a file too big to load
+  EditorPager* pager;
+
+  // Binary file shown as hex, without rows
+  EditorHexView* hex;
+
+  // Append what gets written to the file, like tail -f
+  bool follow;
+  int64_t follow_size;
+  // Following piped input instead of a file
+  bool stream;
+
+  // Tab restored from the last session, until it's loaded and its cursor
+  // is back where it was
+  EditorSessionTab* session;
+
+  // Crash recovery journal of unsaved changes
+  EditorJournal* journal;
+
+  // Undo history from earlier sessions, read when undo gets to it
+  EditorHistory* history;
 
   // Undo redo
   EditorActionList* action_head;
@@ -105,4 +151,7 @@ int editorAddFile(EditorFile* file);
 void editorRemoveFile(int index);
 void editorChangeToFile(int index);
 
+// Background work
+bool editorPollBackground(void);
+
 #endif
@@ -0,0 +1,308 @@
+#include "encoding.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "scan.h"
+#include "unicode.h"
+
+#define REPLACEMENT_CHAR 0xFFFD
+
+static bool isBigEndian(Encoding encoding) {
+  return encoding == ENC_UTF16BE || encoding == ENC_UTF16BE_BOM;
+}
+
+static bool isUTF16(Encoding encoding) {
+  return encoding >= ENC_UTF16LE && encoding <= ENC_UTF16BE_BOM;
+}
+
+// Text that is mostly ASCII has a zero in every other byte
+static Encoding guessUTF16(const uint8_t* p, size_t len) {
+  size_t pairs = len / 2;
+  if (pairs < 2) return ENC_UTF8;
+
+  size_t even_zeros = 0;
+  size_t odd_zeros = 0;
+  for (size_t i = 0; i < pairs; i++) {
+    if (!p[i * 2]) even_zeros++;
+    if (!p[i * 2 + 1]) odd_zeros++;
+  }
+  if (odd_zeros > pairs * 2 / 5 && even_zeros < pairs / 20)
+    return ENC_UTF16LE;
+  if (even_zeros > pairs * 2 / 5 && odd_zeros < pairs / 20)
+    return ENC_UTF16BE;
+  return ENC_UTF8;
+}
+
+Encoding detectEncoding(const char* data, size_t len, bool whole,
+                        size_t* bom_len) {
+  const uint8_t* p = (const uint8_t*)data;
+  *bom_len = 0;
+
+  if (len >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) {
+    *bom_len = 3;
+    return ENC_UTF8_BOM;
+  }
+  if (len >= 2 && p[0] == 0xFF && p[1] == 0xFE) {
+    *bom_len = 2;
+    return ENC_UTF16LE_BOM;
+  }
+  if (len >= 2 && p[0] == 0xFE && p[1] == 0xFF) {
+    *bom_len = 2;
+    return ENC_UTF16BE_BOM;
+  }
+
+  if (len > ENCODING_SAMPLE_SIZE) {
+    len = ENCODING_SAMPLE_SIZE;
+    whole = false;
+  }
+
+  Encoding encoding = guessUTF16(p, len);
+  if (encoding != ENC_UTF8) return encoding;
+
+  // Binary files stay as they are
+  if (memchr(p, '\0', len)) return ENC_UTF8;
+
+  // Don't count a character cut off by the end of the sample
+  if (!whole) {
+    size_t end = len;
+    while (end > 0 && len - end < 3 && (p[end - 1] & 0xC0) == 0x80) end--;
+    if (end > 0 && p[end - 1] >= 0xC0) len = end - 1;
+  }
+
+  // Any byte is a Latin-1 character, so it can be saved back unchanged
+  return isValidUTF8(data, len) ? ENC_UTF8 : ENC_LATIN1;
+}
+
+const char* getEncodingName(Encoding encoding) {
+  switch (encoding) {
+    case ENC_UTF8:
+      return "UTF-8";
+    case ENC_UTF8_BOM:
+      return "UTF-8 BOM";
+    case ENC_UTF16LE:
+      return "UTF-16LE";
+    case ENC_UTF16LE_BOM:
+      return "UTF-16LE BOM";
+    case ENC_UTF16BE:
+      return "UTF-16BE";
+    case ENC_UTF16BE_BOM:
+      return "UTF-16BE BOM";
+    case ENC_LATIN1:
+      return "Latin-1";
+  }
+  return "";
+}
+
+bool isTranscoded(Encoding encoding) {
+  return encoding != ENC_UTF8 && encoding != ENC_UTF8_BOM;
+}
+
+const char* getEncodingBOM(Encoding encoding, size_t* len) {
+  switch (encoding) {
+    case ENC_UTF8_BOM:
+      *len = 3;
+      return "\xEF\xBB\xBF";
+    case ENC_UTF16LE_BOM:
+      *len = 2;
+      return "\xFF\xFE";
+    case ENC_UTF16BE_BOM:
+      *len = 2;
+      return "\xFE\xFF";
+    default:
+      *len = 0;
+      return "";
+  }
+}
+
+// Decoding
+
+size_t decodeTextSize(size_t len) {
+  // Latin-1 doubles at most, UTF-16 grows by half
+  return len * 2 + sizeof(((TextDecoder*)0)->pending) * 2;
+}
+
+static size_t decodeLatin1(const char* in, size_t len, char* out) {
+  char* o = out;
+  size_t i = 0;
+  while (i < len) {
+    size_t ascii = scanASCII(in + i, len - i);
+    memcpy(o, in + i, ascii);
+    o += ascii;
+    i += ascii;
+
+    while (i < len && (uint8_t)in[i] >= 0x80) {
+      uint8_t c = in[i++];
+      *o++ = 0xC0 | (c >> 6);
+      *o++ = 0x80 | (c & 0x3F);
+    }
+  }
+  return o - out;
+}
+
+static uint32_t readUnit(const uint8_t* p, bool big_endian) {
+  return big_endian ? (uint32_t)(p[0] << 8 | p[1])
+                    : (uint32_t)(p[1] << 8 | p[0]);
+}
+
+// Decodes whole characters, used gets how many bytes that was. A character
+// cut off at the end is left for the next input.
+static size_t decodeUTF16(const char* in, size_t len, bool big_endian,
+                          char* out, size_t* used, bool* invalid) {
+  const uint8_t* p = (const uint8_t*)in;
+  char* o = out;
+  size_t i = 0;
+  while (len - i >= 2) {
+    size_t ascii = narrowUTF16(in + i, (len - i) / 2, big_endian, o);
+    i += ascii * 2;
+    o += ascii;
+    if (len - i < 2) break;
+
+    uint32_t unit = readUnit(p + i, big_endian);
+    uint32_t code_point = unit;
+    size_t size = 2;
+    if (unit >= 0xD800 && unit <= 0xDBFF) {
+      if (len - i < 4) break;
+      uint32_t low = readUnit(p + i + 2, big_endian);
+      if (low >= 0xDC00 && low <= 0xDFFF) {
+        code_point = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+        size = 4;
+      } else {
+        code_point = REPLACEMENT_CHAR;
+        *invalid = true;
+      }
+    } else if (unit >= 0xDC00 && unit <= 0xDFFF) {
+      code_point = REPLACEMENT_CHAR;
+      *invalid = true;
+    }
+    o += encodeUTF8(code_point, o);
+    i += size;
+  }
+  *used = i;
+  return o - out;
+}
+
+size_t decodeText(TextDecoder* d, const char* in, size_t len, char* out) {
+  if (d->encoding == ENC_LATIN1) return decodeLatin1(in, len, out);
+  if (!isUTF16(d->encoding)) {
+    memcpy(out, in, len);
+    return len;
+  }
+
+  bool big_endian = isBigEndian(d->encoding);
+  char* o = out;
+  size_t used;
+
+  // Finish the character the last input cut off
+  if (d->pending_len) {
+    char buf[sizeof(d->pending) * 2];
+    size_t n = d->pending_len;
+    size_t take = (len < sizeof(d->pending)) ? len : sizeof(d->pending);
+    memcpy(buf, d->pending, n);
+    memcpy(buf + n, in, take);
+    o += decodeUTF16(buf, n + take, big_endian, o, &used, &d->invalid);
+    if (used >= n) {
+      in += used - n;
+      len -= used - n;
+      d->pending_len = 0;
+    } else {
+      memmove(d->pending, buf + used, n + take - used);
+      d->pending_len = n + take - used;
+      return o - out;
+    }
+  }
+
+  o += decodeUTF16(in, len, big_endian, o, &used, &d->invalid);
+  memcpy(d->pending, in + used, len - used);
+  d->pending_len = len - used;
+  return o - out;
+}
+
+size_t decodeTextFinish(TextDecoder* d, char* out) {
+  if (!d->pending_len) return 0;
+  d->pending_len = 0;
+  d->invalid = true;
+  return encodeUTF8(REPLACEMENT_CHAR, out);
+}
+
+// Encoding
+
+size_t encodeTextSize(size_t len) {
+  // One byte of UTF-8 can become two bytes of UTF-16
+  return len * 2;
+}
+
+static size_t encodeUTF16(const char* in, size_t len, bool big_endian,
+                          char* out) {
+  char* o = out;
+  size_t i = 0;
+  while (i < len) {
+    size_t ascii = widenASCII(in + i, len - i, big_endian, o);
+    i += ascii;
+    o += ascii * 2;
+    if (i == len) break;
+
+    size_t size;
+    uint32_t code_point = decodeUTF8(in + i, len - i, &size);
+    i += size;
+
+    uint32_t units[2];
+    int count = 1;
+    if (code_point >= 0x10000) {
+      code_point -= 0x10000;
+      units[0] = 0xD800 | (code_point >> 10);
+      units[1] = 0xDC00 | (code_point & 0x3FF);
+      count = 2;
+    } else {
+      units[0] = code_point;
+    }
+    for (int j = 0; j < count; j++) {
+      o[big_endian] = units[j] & 0xFF;
+      o[!big_endian] = units[j] >> 8;
+      o += 2;
+    }
+  }
+  return o - out;
+}
+
+static size_t encodeLatin1(const char* in, size_t len, char* out) {
+  char* o = out;
+  size_t i = 0;
+  while (i < len) {
+    size_t ascii = scanASCII(in + i, len - i);
+    memcpy(o, in + i, ascii);
+    o += ascii;
+    i += ascii;
+    if (i == len) break;
+
+    size_t size;
+    uint32_t code_point = decodeUTF8(in + i, len - i, &size);
+    *o++ = (code_point <= 0xFF) ? (char)code_point : '?';
+    i += size;
+  }
+  return o - out;
+}
+
+size_t encodeText(Encoding encoding, const char* in, size_t len, char* out) {
+  if (encoding == ENC_LATIN1) return encodeLatin1(in, len, out);
+  if (isUTF16(encoding)) {
+    return encodeUTF16(in, len, isBigEndian(encoding), out);
+  }
+  memcpy(out, in, len);
+  return len;
+}
+
+bool canEncodeText(Encoding encoding, const char* s, size_t len) {
+  if (encoding != ENC_LATIN1) return true;
+
+  size_t i = 0;
+  while (i < len) {
+    i += scanASCII(s + i, len - i);
+    if (i == len) break;
+
+    size_t size;
+    if (decodeUTF8(s + i, len - i, &size) > 0xFF) return false;
+    i += size;
+  }
+  return true;
+}
@@ -0,0 +1,52 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Rows are always UTF-8. Files in other encodings are converted when they
+// are loaded and converted back when they are saved.
+typedef enum Encoding {
+  ENC_UTF8 = 0,
+  ENC_UTF8_BOM,
+  ENC_UTF16LE,
+  ENC_UTF16LE_BOM,
+  ENC_UTF16BE,
+  ENC_UTF16BE_BOM,
+  ENC_LATIN1,
+} Encoding;
+
+// Bytes looked at to guess a file without a BOM
+#define ENCODING_SAMPLE_SIZE (64 << 10)
+
+// From the BOM, or a sample from the start of the file. bom_len gets the
+// bytes to skip.
+Encoding detectEncoding(const char* data, size_t len, bool whole,
+                        size_t* bom_len);
+const char* getEncodingName(Encoding encoding);
+// Rows have to be converted, not only the BOM
+bool isTranscoded(Encoding encoding);
+// Written in front of the text when saving
+const char* getEncodingBOM(Encoding encoding, size_t* len);
+
+typedef struct TextDecoder {
+  Encoding encoding;
+  // Part of a character cut off at the end of the last input
+  char pending[4];
+  size_t pending_len;
+  bool invalid;
+} TextDecoder;
+
+// Most UTF-8 bytes decodeText writes for len bytes of input
+size_t decodeTextSize(size_t len);
+size_t decodeText(TextDecoder* d, const char* in, size_t len, char* out);
+// At the end of the input, writes what's left of a cut off character
+size_t decodeTextFinish(TextDecoder* d, char* out);
+
+// Most bytes encodeText writes for len bytes of UTF-8
+size_t encodeTextSize(size_t len);
+// in has to be whole characters
+size_t encodeText(Encoding encoding, const char* in, size_t len, char* out);
+bool canEncodeText(Encoding encoding, const char* s, size_t len);
+
+#endif
@@ -2,15 +2,20 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 
+#include "compress.h"
 #include "editor.h"
+#include "encoding.h"
 #include "input.h"
 #include "output.h"
 #include "prompt.h"
 #include "row.h"
+#include "scan.h"
 
 static int isFileOpened(FileInfo info) {
   for (int i = 0; i < editor.file_count; i++) {
@@ -21,36 +26,587 @@ static int isFileOpened(FileInfo info) {
   return -1;
 }
 
-static char* editroRowsToString(EditorFile* file, size_t* len) {
-  size_t total_len = 0;
-  int nl_len = (file->newline == NL_UNIX) ? 1 : 2;
-  for (int i = 0; i < file->num_rows; i++) {
-    total_len += file->row[i].size + nl_len;
+typedef struct LoadState {
+  bool has_end_nl;
+  bool has_cr;
+  bool invalid_utf8;
+  bool broken;
+  uint8_t encoding;
+} LoadState;
+
+static size_t stripNewline(const char* line, size_t len, LoadState* state) {
+  state->has_end_nl = false;
+  while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+    if (line[len - 1] == '\r') state->has_cr = true;
+    state->has_end_nl = true;
+    len--;
   }
+  return len;
+}
 
-  // last line no newline
-  *len = (total_len > 0) ? total_len - nl_len : 0;
+// Rows read on the opening thread, added to the file at once
+typedef VECTOR(EditorRow) LoadRows;
 
-  char* buf = malloc_s(total_len);
-  char* p = buf;
-  for (int i = 0; i < file->num_rows; i++) {
-    memcpy(p, file->row[i].data, file->row[i].size);
-    p += file->row[i].size;
-    if (i != file->num_rows - 1) {
-      if (file->newline == NL_DOS) {
-        *p = '\r';
-        p++;
+// editorInsertRow but faster
+static EditorRow* editorLoadRow(LoadRows* rows) {
+  _vector_make_room((_Vector*)rows, sizeof(EditorRow));
+  return &rows->data[rows->size++];
+}
+
+static void editorAddLoadedRows(EditorFile* file, LoadRows* rows) {
+  editorSpliceRows(file, file->num_rows, 0, rows->data, rows->size);
+  free(rows->data);
+  rows->data = NULL;
+  rows->size = rows->capacity = 0;
+}
+
+// Splits the next line off [p, end) into row and returns the start of the
+// line after it.
+static char* scanRow(char* p, char* end, EditorRow* row, LoadState* state) {
+  int flags;
+  char* nl = (char*)scanLine(p, end, &flags);
+  char* next = (nl < end) ? nl + 1 : end;
+  row->size = stripNewline(p, next - p, state);
+  row->data = p;
+  row->mapped = true;
+  row->ascii = !(flags & LINE_NON_ASCII);
+  row->plain = !flags;
+
+  if (!row->ascii && !isValidUTF8(row->data, row->size)) {
+    state->invalid_utf8 = true;
+  }
+  return next;
+}
+
+static void editorFinishLoad(EditorFile* file, LoadState state) {
+  file->lineno_width = getDigit(file->num_rows) + 2;
+
+  if (state.has_end_nl) {
+    editorInsertRow(file, file->num_rows, "", 0);
+  }
+
+  if (file->num_rows < 2) {
+    file->newline = NL_DEFAULT;
+  } else if (state.has_cr) {
+    file->newline = NL_DOS;
+  } else if (file->num_rows) {
+    file->newline = NL_UNIX;
+  }
+}
+
+static void editorReportLoad(const EditorFile* file, LoadState state) {
+  if (state.broken) {
+    editorMsg("\"%s\" is damaged, only the part before it was loaded.",
+              getBaseName(file->filename));
+  } else if (state.invalid_utf8) {
+    editorMsg("\"%s\" is not valid %s.", getBaseName(file->filename),
+              getEncodingName(file->encoding));
+  }
+}
+
+// Background loading
+
+#define LOAD_BLOCK_ROWS 65536
+#define LOAD_MAX_CHUNKS 64
+// The start of every chunk is read ahead at once
+#define LOAD_READAHEAD_SIZE (16 << 20)
+// Uncompressed files that are converted are read this much at a time
+#define LOAD_STREAM_SIZE (1 << 20)
+
+typedef struct LoadBlock {
+  struct LoadBlock* next;
+  int count;
+  EditorRow rows[LOAD_BLOCK_ROWS];
+} LoadBlock;
+
+typedef struct LoadChunk {
+  thrd_t thread;
+  EditorLoader* loader;
+
+  // Only touched by the worker
+  char* p;
+  char* end;
+  // Compressed or converted files are a single chunk whose rows are copies.
+  // Compressed ones are read from stream and their encoding is found by the
+  // worker.
+  bool streamed;
+  Decompressor* stream;
+  Encoding encoding;
+
+  // Text of streamed rows, only written by the worker. The file takes it
+  // once the worker is done.
+  EditorAddBuffer text;
+
+  // Guarded by the loader mutex
+  LoadBlock* head;
+  LoadBlock* tail;
+  bool done;
+  LoadState state;
+} LoadChunk;
+
+// The rest of the file is split into chunks that start at line boundaries.
+// Every chunk is scanned by its own worker and the main thread appends the
+// rows chunk by chunk, so they end up in file order.
+struct EditorLoader {
+  mtx_t mutex;
+  AsyncIO* readahead;
+
+  // Guarded by mutex
+  size_t loaded_size;
+  bool cancel;
+
+  // Only touched by the main thread
+  LoadState state;
+  int merged;
+  int started;
+
+  int chunk_count;
+  LoadChunk chunks[];
+};
+
+static LoadBlock* loaderNewBlock(void) {
+  LoadBlock* block = malloc_s(sizeof(LoadBlock));
+  block->next = NULL;
+  block->count = 0;
+  return block;
+}
+
+// Hand rows over to the main thread, returns true if the load was cancelled
+static bool loaderPushBlock(LoadChunk* chunk, LoadBlock* block,
+                            size_t loaded) {
+  EditorLoader* loader = chunk->loader;
+  mtx_lock(&loader->mutex);
+  if (chunk->tail) {
+    chunk->tail->next = block;
+  } else {
+    chunk->head = block;
+  }
+  chunk->tail = block;
+  loader->loaded_size += loaded;
+  bool cancel = loader->cancel;
+  mtx_unlock(&loader->mutex);
+  return cancel;
+}
+
+static void loaderFinishChunk(LoadChunk* chunk, LoadState state) {
+  EditorLoader* loader = chunk->loader;
+  mtx_lock(&loader->mutex);
+  chunk->state = state;
+  chunk->done = true;
+  mtx_unlock(&loader->mutex);
+  wakeMainLoop();
+}
+
+static int loaderThread(void* arg) {
+  LoadChunk* chunk = arg;
+  LoadState state = {0};
+  bool cancel = false;
+
+  while (chunk->p < chunk->end && !cancel) {
+    LoadBlock* block = loaderNewBlock();
+    char* start = chunk->p;
+    while (chunk->p < chunk->end && block->count < LOAD_BLOCK_ROWS) {
+      chunk->p = scanRow(chunk->p, chunk->end, &block->rows[block->count],
+                         &state);
+      block->count++;
+    }
+    cancel = loaderPushBlock(chunk, block, chunk->p - start);
+  }
+
+  loaderFinishChunk(chunk, state);
+  return 0;
+}
+
+// Decompressed lines don't stay anywhere, so they are copied to the text of
+// the chunk
+static void streamAddRow(LoadChunk* chunk, LoadBlock* block, const char* line,
+                         size_t len, LoadState* state) {
+  EditorRow* row = &block->rows[block->count++];
+  row->size = stripNewline(line, len, state);
+  row->data = editorAddText(&chunk->text, line, row->size);
+  row->mapped = true;
+  editorUpdateRow(row);
+  if (!row->ascii && !isValidUTF8(row->data, row->size)) {
+    state->invalid_utf8 = true;
+  }
+}
+
+// Next piece of a streamed chunk, progress gets the input bytes used so far.
+// Returns 0 at the end and -1 if the data is broken.
+static int64_t streamRead(LoadChunk* chunk, const char* start,
+                          const char** data, size_t* progress) {
+  if (chunk->stream) {
+    int64_t n = decompressRead(chunk->stream, data);
+    *progress = decompressProgress(chunk->stream);
+    return n;
+  }
+
+  size_t n = chunk->end - chunk->p;
+  if (n > LOAD_STREAM_SIZE) n = LOAD_STREAM_SIZE;
+  *data = chunk->p;
+  chunk->p += n;
+  *progress = chunk->p - start;
+  return n;
+}
+
+// Rows are built here while the decompressor runs on its own thread, after
+// converting the text to UTF-8
+static int streamThread(void* arg) {
+  LoadChunk* chunk = arg;
+  LoadState state = {.has_end_nl = true};
+  bool cancel = false;
+
+  TextDecoder decoder = {.encoding = chunk->encoding};
+  bool detect = (chunk->stream != NULL);
+  char* text = NULL;
+  size_t text_cap = 0;
+
+  // A line cut off at the end of a buffer
+  abuf partial = ABUF_INIT;
+  const char* start = chunk->p;
+  size_t consumed = 0;
+  size_t progress;
+  const char* data;
+  int64_t n = 0;
+  while (!cancel && (n = streamRead(chunk, start, &data, &progress)) > 0) {
+    if (detect) {
+      size_t bom_len;
+      decoder.encoding = detectEncoding(data, n, false, &bom_len);
+      data += bom_len;
+      n -= bom_len;
+      detect = false;
+    }
+    if (isTranscoded(decoder.encoding)) {
+      size_t size = decodeTextSize(n);
+      if (size > text_cap) {
+        text_cap = size;
+        text = realloc_s(text, text_cap);
       }
-      *p = '\n';
-      p++;
+      n = decodeText(&decoder, data, n, text);
+      data = text;
     }
+
+    LoadBlock* block = loaderNewBlock();
+    const char* p = data;
+    const char* end = data + n;
+    while (p < end) {
+      const char* nl = memchr(p, '\n', end - p);
+      if (!nl) {
+        abufAppendN(&partial, p, end - p);
+        break;
+      }
+
+      if (block->count == LOAD_BLOCK_ROWS) {
+        cancel = loaderPushBlock(chunk, block, 0);
+        block = loaderNewBlock();
+      }
+      if (partial.len) {
+        abufAppendN(&partial, p, nl + 1 - p);
+        streamAddRow(chunk, block, partial.buf, partial.len, &state);
+        partial.len = 0;
+      } else {
+        streamAddRow(chunk, block, p, nl + 1 - p, &state);
+      }
+      p = nl + 1;
+    }
+
+    cancel = loaderPushBlock(chunk, block, progress - consumed) || cancel;
+    consumed = progress;
+  }
+
+  // A character cut off by the end of the file
+  char rest[8];
+  size_t rest_len = decodeTextFinish(&decoder, rest);
+  abufAppendN(&partial, rest, rest_len);
+
+  if (!cancel && partial.len) {
+    LoadBlock* block = loaderNewBlock();
+    streamAddRow(chunk, block, partial.buf, partial.len, &state);
+    loaderPushBlock(chunk, block, 0);
   }
+  abufFree(&partial);
+  free(text);
+  if (n < 0) state.broken = true;
+  if (decoder.invalid) state.invalid_utf8 = true;
+  state.encoding = decoder.encoding;
 
-  return buf;
+  loaderFinishChunk(chunk, state);
+  return 0;
 }
 
-bool editorOpen(EditorFile* file, const char* path) {
+static void editorFreeLoader(EditorFile* file, EditorLoader* loader) {
+  for (int i = loader->merged; i < loader->started; i++) {
+    thrd_join(loader->chunks[i].thread, NULL);
+  }
+  asyncFree(loader->readahead);
+  for (int i = 0; i < loader->chunk_count; i++) {
+    decompressFree(loader->chunks[i].stream);
+    // Rows that were merged can point into it
+    editorTakeAddBuffer(&file->add, &loader->chunks[i].text);
+    LoadBlock* block = loader->chunks[i].head;
+    while (block) {
+      LoadBlock* next = block->next;
+      free(block);
+      block = next;
+    }
+  }
+  mtx_destroy(&loader->mutex);
+  free(loader);
+}
+
+static bool editorRunLoader(EditorFile* file, EditorLoader* loader,
+                            thrd_start_t run) {
+  for (int i = 0; i < loader->chunk_count; i++) {
+    if (thrd_create(&loader->chunks[i].thread, run, &loader->chunks[i]) !=
+        thrd_success) {
+      mtx_lock(&loader->mutex);
+      loader->cancel = true;
+      mtx_unlock(&loader->mutex);
+      editorFreeLoader(file, loader);
+      return false;
+    }
+    loader->started++;
+  }
+
+  file->loader = loader;
+  return true;
+}
+
+static bool editorStartLoad(EditorFile* file, char* p, LoadState state) {
+  char* end = file->map.data + file->map.size;
+
+  int chunk_count = 1;
+  if ((size_t)(end - p) > EDITOR_PARALLEL_LOAD_SIZE) {
+    chunk_count = getCpuCount();
+    if (chunk_count > LOAD_MAX_CHUNKS) chunk_count = LOAD_MAX_CHUNKS;
+  }
+
+  EditorLoader* loader = calloc_s(
+      1, sizeof(EditorLoader) + sizeof(LoadChunk) * chunk_count);
+  loader->loaded_size = p - file->map.data;
+  loader->state = state;
+
+  size_t chunk_size = (end - p) / chunk_count;
+  for (int i = 0; i < chunk_count && p < end; i++) {
+    char* chunk_end = end;
+    if (i != chunk_count - 1 && (size_t)(end - p) > chunk_size) {
+      chunk_end = memchr(p + chunk_size, '\n', end - (p + chunk_size));
+      chunk_end = chunk_end ? chunk_end + 1 : end;
+    }
+
+    LoadChunk* chunk = &loader->chunks[loader->chunk_count++];
+    chunk->loader = loader;
+    chunk->p = p;
+    chunk->end = chunk_end;
+    p = chunk_end;
+  }
+
+  if (mtx_init(&loader->mutex, mtx_plain) != thrd_success) {
+    free(loader);
+    return false;
+  }
+
+  // Slow storage gets the first part of every chunk requested in one go,
+  // instead of one page fault after another
+  loader->readahead = asyncInit(LOAD_MAX_CHUNKS);
+  for (int i = 0; loader->readahead && i < loader->chunk_count; i++) {
+    LoadChunk* chunk = &loader->chunks[i];
+    size_t len = chunk->end - chunk->p;
+    if (len > LOAD_READAHEAD_SIZE) len = LOAD_READAHEAD_SIZE;
+    asyncReadahead(loader->readahead, &file->map, chunk->p - file->map.data,
+                   len);
+  }
+
+  return editorRunLoader(file, loader, loaderThread);
+}
+
+// Rows of compressed or converted files are copied out of a stream, which
+// starts after skip bytes of BOM
+static bool editorStartStream(EditorFile* file, CompressType type,
+                              Encoding encoding, size_t skip) {
+  Decompressor* stream = NULL;
+  if (type != COMPRESS_NONE) {
+    stream = decompressStart(type, file->map.data, file->map.size);
+    if (!stream) return false;
+  }
+
+  EditorLoader* loader =
+      calloc_s(1, sizeof(EditorLoader) + sizeof(LoadChunk));
+  loader->state.has_end_nl = true;
+  loader->chunk_count = 1;
+
+  LoadChunk* chunk = &loader->chunks[0];
+  chunk->loader = loader;
+  chunk->p = file->map.data + skip;
+  chunk->end = file->map.data + file->map.size;
+  chunk->streamed = true;
+  chunk->stream = stream;
+  chunk->encoding = encoding;
+
+  if (mtx_init(&loader->mutex, mtx_plain) != thrd_success) {
+    decompressFree(stream);
+    free(loader);
+    return false;
+  }
+
+  if (!editorRunLoader(file, loader, streamThread)) return false;
+  file->compress = type;
+  file->encoding = encoding;
+  return true;
+}
+
+static void editorMergeBlocks(EditorFile* file, LoadBlock* block) {
+  while (block) {
+    editorSpliceRows(file, file->num_rows, 0, block->rows, block->count);
+
+    LoadBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+}
+
+bool editorPollLoad(EditorFile* file) {
+  EditorLoader* loader = file->loader;
+  if (!loader) return false;
+
+  bool updated = false;
+  while (loader->merged < loader->chunk_count) {
+    LoadChunk* chunk = &loader->chunks[loader->merged];
+
+    mtx_lock(&loader->mutex);
+    LoadBlock* block = chunk->head;
+    chunk->head = chunk->tail = NULL;
+    bool done = chunk->done;
+    mtx_unlock(&loader->mutex);
+
+    if (block) {
+      editorMergeBlocks(file, block);
+      updated = true;
+    }
+    if (!done) break;
+
+    thrd_join(chunk->thread, NULL);
+    editorTakeAddBuffer(&file->add, &chunk->text);
+    loader->state.has_end_nl = chunk->state.has_end_nl;
+    loader->state.has_cr |= chunk->state.has_cr;
+    loader->state.invalid_utf8 |= chunk->state.invalid_utf8;
+    loader->state.broken |= chunk->state.broken;
+    if (chunk->streamed) loader->state.encoding = chunk->state.encoding;
+    loader->merged++;
+    updated = true;
+  }
+
+  if (!updated) return false;
+
+  file->lineno_width = getDigit(file->num_rows) + 2;
+
+  if (loader->merged == loader->chunk_count) {
+    LoadState state = loader->state;
+    editorFreeLoader(file, loader);
+    file->loader = NULL;
+    file->encoding = state.encoding;
+    editorFinishLoad(file, state);
+    editorReportLoad(file, state);
+    // Rows of a compressed file don't point into it
+    if (file->compress) unmapFile(&file->map);
+    editorLoadHistory(file);
+    editorRecoverJournal(file);
+  }
+  return true;
+}
+
+int editorLoadProgress(EditorFile* file) {
+  EditorLoader* loader = file->loader;
+  if (!loader) return 100;
+
+  mtx_lock(&loader->mutex);
+  size_t loaded_size = loader->loaded_size;
+  mtx_unlock(&loader->mutex);
+
+  return (int)(loaded_size * 100 / file->map.size);
+}
+
+void editorCancelLoad(EditorFile* file) {
+  if (!file->loader) return;
+
+  mtx_lock(&file->loader->mutex);
+  file->loader->cancel = true;
+  mtx_unlock(&file->loader->mutex);
+
+  editorFreeLoader(file, file->loader);
+  file->loader = NULL;
+}
+
+static void editorDetachMap(EditorFile* file, size_t size) {
+  char* start = file->map.data;
+  char* end = start + file->map.size;
+  for (int i = 0; i < file->num_rows; i++) {
+    EditorRow* row = editorGetRow(file, i);
+    if (!row->mapped || row->data < start || row->data >= end) continue;
+
+    size_t offset = row->data - start;
+    size_t len = row->size;
+    if (offset >= size) {
+      len = 0;
+    } else if (offset + len > size) {
+      len = size - offset;
+    }
+    row->data = editorAddText(&file->add, row->data, len);
+    row->size = len;
+    editorUpdateRow(row);
+  }
+  unmapFile(&file->map);
+}
+
+bool editorPollMap(EditorFile* file) {
+  // Workers still reading the mapping only see zeros past the end
+  if (file->loader || file->saver || file->pager || file->hex) return false;
+
+  int64_t size = getMapFileSize(&file->map);
+  if (size < 0 || (size_t)size >= file->map.size) return false;
+
+  editorDetachMap(file, size);
+  editorMsg("\"%s\" was truncated on disk, the lines past its end are gone.",
+            getBaseName(file->filename));
+  return true;
+}
+
+// A file being opened. Everything that can show a message runs on the main
+// thread, reading the file doesn't and can run on a worker.
+typedef struct OpenJob {
+  EditorFile file;
+  FILE* fp;
+  bool view;
+  bool regular;
+
+  // Found while reading, reported on the main thread
+  bool too_big;
+  CompressType unsupported;
+  LoadState state;
+
+  bool done;
+} OpenJob;
+
+static bool isFileOpening(const OpenJob* jobs, int count, FileInfo info) {
+  for (int i = 0; i < count; i++) {
+    if (jobs[i].regular && areFilesEqual(jobs[i].file.file_info, info))
+      return true;
+  }
+  return false;
+}
+
+// Check the path and open it. Files listed earlier in the same batch count
+// as already open.
+static bool editorPrepareOpen(OpenJob* job, const char* path,
+                              const OpenJob* batch, int batch_count) {
+  EditorFile* file = &job->file;
   editorInitFile(file);
+  job->fp = NULL;
+  job->regular = false;
+  job->too_big = false;
+  job->unsupported = COMPRESS_NONE;
+  job->state = (LoadState){.has_end_nl = true};
+  job->done = false;
 
   FileType type = getFileType(path);
   switch (type) {
@@ -67,6 +623,8 @@ bool editorOpen(EditorFile* file, const char* path) {
         editorChangeToFile(open_index);
         return false;
       }
+      if (isFileOpening(batch, batch_count, file_info)) return false;
+      job->regular = true;
     } break;
 
     case FT_DIR:
@@ -115,61 +673,718 @@ bool editorOpen(EditorFile* file, const char* path) {
     return true;
   }
 
-  bool has_end_nl = true;
-  bool has_cr = false;
-  size_t at = 0;
-  size_t cap = 16;
+  job->fp = fp;
+  return true;
+}
 
-  char* line = NULL;
-  size_t n = 0;
-  int64_t len;
+// Build the rows of an opened file. Only touches the job, so files can be
+// read at the same time.
+static void editorReadFile(OpenJob* job) {
+  EditorFile* file = &job->file;
+  FILE* fp = job->fp;
+  LoadState* state = &job->state;
+  LoadRows rows = {0};
 
-  file->row = malloc_s(sizeof(EditorRow) * cap);
+  if (mapFile(&file->map, fp)) {
+    // Compressed files are decompressed straight into rows
+    CompressType compress = getCompressType(file->map.data, file->map.size);
+    if (compress != COMPRESS_NONE) {
+      if (editorStartStream(file, compress, ENC_UTF8, 0)) {
+        fclose(fp);
+        return;
+      }
+      job->unsupported = compress;
+    }
 
-  while ((len = getLine(&line, &n, fp)) != -1) {
-    has_end_nl = false;
-    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
-      if (line[len - 1] == '\r') has_cr = true;
-      has_end_nl = true;
-      len--;
+    // Text in other encodings is converted into rows the same way
+    size_t bom_len = 0;
+    Encoding encoding = ENC_UTF8;
+    if (job->unsupported == COMPRESS_NONE) {
+      encoding =
+          detectEncoding(file->map.data, file->map.size, true, &bom_len);
     }
-    // editorInsertRow but faster
-    if (at >= cap) {
-      cap *= 2;
-      file->row = realloc_s(file->row, sizeof(EditorRow) * cap);
+    if (isTranscoded(encoding)) {
+      if (editorStartStream(file, COMPRESS_NONE, encoding, bom_len)) {
+        fclose(fp);
+        return;
+      }
+      encoding = ENC_UTF8;
+      bom_len = 0;
     }
-    file->row[at].size = len;
-    file->row[at].data = line;
+    file->encoding = encoding;
+    state->encoding = encoding;
 
-    editorUpdateRow(&file->row[at]);
+    // Binary files are shown as hex instead of rows of control characters
+    if (encoding == ENC_UTF8 && isBinaryData(file->map.data, file->map.size)) {
+      editorStartHexView(file);
+      fclose(fp);
+      return;
+    }
+
+    // Don't build rows for every line when there isn't enough memory
+    job->too_big =
+        file->map.size > getMemorySize() / EDITOR_VIEW_MEMORY_RATIO;
+    if ((job->view || job->too_big) && editorStartPager(file)) {
+      fclose(fp);
+      return;
+    }
+    job->too_big = false;
 
-    line = NULL;
-    n = 0;
-    at++;
+    // Rows point into the mapping until they are edited
+    char* p = file->map.data + bom_len;
+    char* end = file->map.data + file->map.size;
+
+    // For large files only the first screen is loaded here, the rest is
+    // loaded in the background.
+    bool async = file->map.size > EDITOR_ASYNC_LOAD_SIZE;
+    while (p < end && (!async || rows.size <= (size_t)editor.display_rows)) {
+      p = scanRow(p, end, editorLoadRow(&rows), state);
+    }
+    editorAddLoadedRows(file, &rows);
+
+    if (p < end && editorStartLoad(file, p, *state)) {
+      file->lineno_width = getDigit(file->num_rows) + 2;
+      if (state->has_cr) file->newline = NL_DOS;
+      // Reported when the background load finishes
+      state->invalid_utf8 = false;
+      fclose(fp);
+      return;
+    }
+
+    while (p < end) {
+      p = scanRow(p, end, editorLoadRow(&rows), state);
+    }
+  } else {
+    char* line = NULL;
+    size_t n = 0;
+    int64_t len;
+
+    // Lines are read into one buffer and copied to the add buffer
+    while ((len = getLine(&line, &n, fp)) != -1) {
+      EditorRow* row = editorLoadRow(&rows);
+      row->size = stripNewline(line, len, state);
+      row->data = editorAddText(&file->add, line, row->size);
+      row->mapped = true;
+      editorUpdateRow(row);
+      if (!row->ascii && !isValidUTF8(row->data, row->size)) {
+        state->invalid_utf8 = true;
+      }
+    }
+    free(line);
   }
-  file->row = realloc_s(file->row, sizeof(EditorRow) * at);
-  file->num_rows = at;
-  file->lineno_width = getDigit(file->num_rows) + 2;
 
-  if (has_end_nl) {
-    editorInsertRow(file, file->num_rows, "", 0);
+  editorAddLoadedRows(file, &rows);
+  editorFinishLoad(file, *state);
+  fclose(fp);
+}
+
+static void editorReportOpen(const OpenJob* job) {
+  if (job->unsupported != COMPRESS_NONE) {
+    editorMsg("\"%s\" is %s compressed, which this build can't read.",
+              getBaseName(job->file.filename),
+              getCompressName(job->unsupported));
   }
+  if (job->too_big) {
+    editorMsg("\"%s\" is too big to edit, opened in view mode.",
+              getBaseName(job->file.filename));
+  }
+  editorReportLoad(&job->file, job->state);
+}
 
-  if (file->num_rows < 2) {
-    file->newline = NL_DEFAULT;
-  } else if (has_cr) {
-    file->newline = NL_DOS;
-  } else if (file->num_rows) {
-    file->newline = NL_UNIX;
+static bool editorOpenFile(EditorFile* file, const char* path, bool view) {
+  OpenJob job;
+  job.view = view;
+  bool opened = editorPrepareOpen(&job, path, NULL, 0);
+  if (opened && job.fp) {
+    editorReadFile(&job);
+    editorReportOpen(&job);
   }
+  *file = job.file;
+  return opened;
+}
 
-  free(line);
-  fclose(fp);
+bool editorOpen(EditorFile* file, const char* path) {
+  return editorOpenFile(file, path, false);
+}
+
+bool editorOpenView(EditorFile* file, const char* path) {
+  return editorOpenFile(file, path, true);
+}
+
+// Opening several files
+
+#define OPEN_MAX_THREADS 16
+
+typedef struct OpenBatch {
+  OpenJob* jobs;
+  int count;
+  atomic_int next;
+
+  mtx_t mutex;
+  cnd_t cond;
+} OpenBatch;
+
+static int openThread(void* arg) {
+  OpenBatch* batch = arg;
+  int i;
+  while ((i = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+    OpenJob* job = &batch->jobs[i];
+    if (job->fp) editorReadFile(job);
+
+    mtx_lock(&batch->mutex);
+    job->done = true;
+    cnd_broadcast(&batch->cond);
+    mtx_unlock(&batch->mutex);
+  }
+  return 0;
+}
 
+void editorOpenFiles(char* const* paths, const bool* view, int count) {
+  if (count <= 0) return;
+
+  // Paths are checked in order, a directory changes where the next relative
+  // path is
+  OpenBatch batch = {0};
+  batch.jobs = malloc_s(sizeof(OpenJob) * count);
+  for (int i = 0; i < count; i++) {
+    if (editor.file_count + batch.count >= EDITOR_FILE_MAX_SLOT) {
+      editorMsg("Already opened too many files!");
+      break;
+    }
+    OpenJob* job = &batch.jobs[batch.count];
+    job->view = view[i];
+    if (editorPrepareOpen(job, paths[i], batch.jobs, batch.count))
+      batch.count++;
+  }
+
+  int thread_count = getCpuCount();
+  if (thread_count > OPEN_MAX_THREADS) thread_count = OPEN_MAX_THREADS;
+  if (thread_count > batch.count) thread_count = batch.count;
+  if (batch.count < 2 || mtx_init(&batch.mutex, mtx_plain) != thrd_success)
+    thread_count = 0;
+  if (thread_count && cnd_init(&batch.cond) != thrd_success) {
+    mtx_destroy(&batch.mutex);
+    thread_count = 0;
+  }
+
+  thrd_t threads[OPEN_MAX_THREADS];
+  int started = 0;
+  while (started < thread_count &&
+         thrd_create(&threads[started], openThread, &batch) == thrd_success) {
+    started++;
+  }
+
+  // Added in the order they were given, each one as soon as it's read
+  for (int i = 0; i < batch.count; i++) {
+    OpenJob* job = &batch.jobs[i];
+    if (started) {
+      mtx_lock(&batch.mutex);
+      while (!job->done) cnd_wait(&batch.cond, &batch.mutex);
+      mtx_unlock(&batch.mutex);
+    } else if (job->fp) {
+      editorReadFile(job);
+    }
+
+    editorReportOpen(job);
+    editorAddFile(&job->file);
+
+    // Show the first file while the others are still being read
+    if (editor.loading) {
+      editor.loading = false;
+      editorRefreshScreen();
+    }
+  }
+
+  for (int i = 0; i < started; i++) {
+    thrd_join(threads[i], NULL);
+  }
+  if (thread_count) {
+    cnd_destroy(&batch.cond);
+    mtx_destroy(&batch.mutex);
+  }
+  free(batch.jobs);
+}
+
+// Unchanged ranges at least this big are copied from the original file
+#define SAVE_COPY_MIN (64 << 10)
+// Edited text is written in requests about this big, this many at once
+#define SAVE_REQUEST_SIZE (1 << 20)
+#define SAVE_QUEUE_DEPTH 16
+// Rows are read and written in batches of at most this many ranges, and
+// a batch stops growing once it's this big
+#define SAVE_BATCH_VECS 1024
+#define SAVE_BATCH_SIZE (SAVE_REQUEST_SIZE * SAVE_QUEUE_DEPTH)
+
+// Ranges to write. Ranges that follow each other in memory are merged.
+typedef struct SaveRanges {
+  IOVec* vec;
+  int count;
+  int cap;
+  size_t len;
+} SaveRanges;
+
+// Saves run on their own thread. Unchanged rows still point into the file
+// mapping, which stays valid until the file is closed. The worker reads the
+// rows a batch at a time and nothing is copied, until an edit comes first.
+// Then the rows it hasn't read yet are copied, edited ones with their text,
+// and editing goes on while it writes them.
+struct EditorSaver {
+  thrd_t thread;
+  atomic_bool done;
+
+  // reading is set while the worker reads a batch of rows. freeze asks it
+  // to stop for the copy, frozen is set once the rows are no longer read.
+  mtx_t mutex;
+  cnd_t cond;
+  bool reading;
+  bool freeze;
+  bool frozen;
+
+  // Only touched by the worker until done is set
+  FILE* fp;
+  FileMap map;
+  char path[EDITOR_PATH_MAX];
+  char temp_path[EDITOR_PATH_MAX];
+  bool success;
+  int error;
+  size_t len;
+
+  // Rows of the revision being written
+  const EditorRowTree* rows;
+  int num_rows;
+  int next_row;
+  const char* nl;
+  size_t nl_len;
+  SaveRanges batch;
+
+  // The rest of the rows once frozen
+  SaveRanges rest;
+  int rest_next;
+  char* text;
+
+  // Written back the way the file was compressed and encoded
+  CompressType compress;
+  Encoding encoding;
+  bool stream;
+  Compressor* c;
+  char* buf;
+  size_t buf_cap;
+  AsyncIO* aio;
+  int64_t offset;
+
+  // Revision being written
+  int dirty;
+  uint64_t revision;
+  int64_t journal_size;
+  HistoryWrite history;
+};
+
+static void rangesAppend(SaveRanges* ranges, const char* data, size_t len) {
+  if (len == 0) return;
+  ranges->len += len;
+
+  // Unchanged lines next to each other in the mapping become one range
+  if (ranges->count) {
+    IOVec* last = &ranges->vec[ranges->count - 1];
+    if (last->data + last->len == data) {
+      last->len += len;
+      return;
+    }
+  }
+
+  if (ranges->count == ranges->cap) {
+    ranges->cap = ranges->cap ? ranges->cap * 2 : 64;
+    ranges->vec = realloc_s(ranges->vec, sizeof(IOVec) * ranges->cap);
+  }
+  ranges->vec[ranges->count++] = (IOVec){data, len};
+}
+
+static void saverAppendRow(const EditorSaver* saver, SaveRanges* ranges,
+                           const EditorRow* row, bool is_last) {
+  rangesAppend(ranges, row->data, row->size);
+  if (is_last) return;
+
+  // Use the newline that follows the row in the file if it's the same
+  const FileMap* map = &saver->map;
+  const char* row_end = row->data + row->size;
+  if (row->mapped && row->data >= map->data &&
+      row_end + saver->nl_len <= map->data + map->size &&
+      memcmp(row_end, saver->nl, saver->nl_len) == 0) {
+    rangesAppend(ranges, row_end, saver->nl_len);
+  } else {
+    rangesAppend(ranges, saver->nl, saver->nl_len);
+  }
+}
+
+// Runs on the worker, edited rows are written from where they are
+static bool saverVisitRow(const EditorRow* row, void* arg) {
+  EditorSaver* saver = arg;
+  SaveRanges* batch = &saver->batch;
+  if (batch->count + 2 > batch->cap || batch->len >= SAVE_BATCH_SIZE) {
+    return false;
+  }
+  saverAppendRow(saver, batch, row, saver->next_row == saver->num_rows - 1);
+  saver->next_row++;
   return true;
 }
 
+// Copies the rows the worker hasn't read yet, on the main thread
+static void saverCopyRows(EditorSaver* saver, const EditorFile* file) {
+  size_t text_size = 1;
+  for (int i = saver->next_row; i < saver->num_rows; i++) {
+    const EditorRow* row = editorGetRow(file, i);
+    if (!row->mapped) text_size += row->size;
+  }
+  saver->text = malloc_s(text_size);
+  char* text = saver->text;
+
+  for (int i = saver->next_row; i < saver->num_rows; i++) {
+    EditorRow row = *editorGetRow(file, i);
+    if (!row.mapped) {
+      memcpy(text, row.data, row.size);
+      row.data = text;
+      text += row.size;
+    }
+    saverAppendRow(saver, &saver->rest, &row, i == saver->num_rows - 1);
+  }
+  saver->next_row = saver->num_rows;
+}
+
+void editorFreezeSave(EditorFile* file) {
+  EditorSaver* saver = file->saver;
+  if (!saver) return;
+
+  mtx_lock(&saver->mutex);
+  saver->freeze = true;
+  while (saver->reading) cnd_wait(&saver->cond, &saver->mutex);
+  if (!saver->frozen) {
+    saverCopyRows(saver, file);
+    saver->frozen = true;
+  }
+  cnd_broadcast(&saver->cond);
+  mtx_unlock(&saver->mutex);
+}
+
+static bool saverIsUnchanged(const EditorSaver* saver, const IOVec* vec) {
+  const FileMap* map = &saver->map;
+  return map->data && vec->len >= SAVE_COPY_MIN && vec->data >= map->data &&
+         vec->data + vec->len <= map->data + map->size;
+}
+
+static bool saverPut(EditorSaver* saver, const char* data, size_t len) {
+  if (!len) return true;
+  return saver->c ? compressWrite(saver->c, data, len)
+                  : fwrite(data, 1, len, saver->fp) == len;
+}
+
+// Compressed or converted files can only be written in order
+static bool saverWriteStream(EditorSaver* saver, const IOVec* vec, int count) {
+  bool transcode = isTranscoded(saver->encoding);
+  bool success = true;
+  for (int i = 0; i < count && success; i++) {
+    const char* data = vec[i].data;
+    size_t left = vec[i].len;
+    while (left > 0 && success) {
+      size_t len = left;
+      if (transcode && len > SAVE_REQUEST_SIZE) {
+        // Don't cut a character in half
+        len = SAVE_REQUEST_SIZE;
+        while (len > 1 && (data[len] & 0xC0) == 0x80) len--;
+      }
+
+      if (transcode) {
+        size_t size = encodeTextSize(len);
+        if (size > saver->buf_cap) {
+          saver->buf_cap = size;
+          saver->buf = realloc_s(saver->buf, saver->buf_cap);
+        }
+        size_t n = encodeText(saver->encoding, data, len, saver->buf);
+        success = saverPut(saver, saver->buf, n);
+      } else {
+        success = saverPut(saver, data, len);
+      }
+      data += len;
+      left -= len;
+    }
+  }
+  return success;
+}
+
+static bool saverWrite(EditorSaver* saver, const IOVec* vec, int count) {
+  if (saver->stream) return saverWriteStream(saver, vec, count);
+
+  // Every range goes at its own offset, so the requests don't have to
+  // finish in order
+  AsyncIO* aio = saver->aio;
+  bool success = true;
+  int64_t offset = saver->offset;
+  size_t pending = 0;
+  int start = 0;
+  for (int i = 0; i < count && success; i++) {
+    if (saverIsUnchanged(saver, &vec[i])) {
+      // Only the modified bytes before it go through user space
+      success = asyncWrite(aio, saver->fp, &vec[start], i - start, offset) &&
+                writeFileFromMap(saver->fp, offset + pending, &saver->map,
+                                 vec[i].data - saver->map.data, vec[i].len);
+      offset += pending + vec[i].len;
+      pending = 0;
+      start = i + 1;
+      continue;
+    }
+
+    pending += vec[i].len;
+    if (pending >= SAVE_REQUEST_SIZE || i + 1 - start == ASYNC_IOV_MAX) {
+      success = asyncWrite(aio, saver->fp, &vec[start], i + 1 - start, offset);
+      offset += pending;
+      pending = 0;
+      start = i + 1;
+    }
+  }
+  if (success) {
+    success = asyncWrite(aio, saver->fp, &vec[start], count - start, offset);
+  }
+  saver->offset = offset + pending;
+
+  // The ranges can point into rows, which can change once they're written
+  int error = errno;
+  if (!asyncWait(aio) && success) {
+    success = false;
+    error = errno;
+  }
+  errno = error;
+  return success;
+}
+
+static bool saverBegin(EditorSaver* saver) {
+  saver->stream = saver->compress || isTranscoded(saver->encoding);
+  if (saver->stream && saver->compress) {
+    saver->c = compressStart(saver->compress, saver->fp);
+    if (!saver->c) {
+      errno = ENOMEM;
+      return false;
+    }
+  }
+  if (!saver->stream) {
+    saver->aio = asyncInit(SAVE_QUEUE_DEPTH);
+    if (!saver->aio) return false;
+  }
+
+  // Converted files get their BOM as it is, not encoded again
+  IOVec bom;
+  bom.data = getEncodingBOM(saver->encoding, &bom.len);
+  saver->len += bom.len;
+  return saver->stream ? saverPut(saver, bom.data, bom.len)
+                       : saverWrite(saver, &bom, 1);
+}
+
+static bool saverEnd(EditorSaver* saver, bool success) {
+  int error = errno;
+  if (saver->c && !compressFinish(saver->c) && success) {
+    success = false;
+    error = errno;
+  }
+  if (saver->aio) asyncFree(saver->aio);
+  errno = error;
+  if (!success && !errno) errno = EIO;
+  return success;
+}
+
+// Whether the next batch comes from the rows, on the worker
+static bool saverStartBatch(EditorSaver* saver) {
+  mtx_lock(&saver->mutex);
+  while (saver->freeze && !saver->frozen) {
+    cnd_wait(&saver->cond, &saver->mutex);
+  }
+  saver->reading = !saver->frozen;
+  mtx_unlock(&saver->mutex);
+  return saver->reading;
+}
+
+static void saverEndBatch(EditorSaver* saver, bool success) {
+  mtx_lock(&saver->mutex);
+  saver->reading = false;
+  if (!success || saver->next_row == saver->num_rows) saver->frozen = true;
+  cnd_broadcast(&saver->cond);
+  mtx_unlock(&saver->mutex);
+}
+
+static int saverThread(void* arg) {
+  EditorSaver* saver = arg;
+
+  errno = 0;
+  bool success = saverBegin(saver);
+  while (success) {
+    bool reading = saverStartBatch(saver);
+    const IOVec* vec;
+    int count;
+    if (reading) {
+      saver->batch.count = 0;
+      saver->batch.len = 0;
+      editorWalkRows(saver->rows, saver->next_row, saverVisitRow, saver);
+      vec = saver->batch.vec;
+      count = saver->batch.count;
+    } else {
+      vec = &saver->rest.vec[saver->rest_next];
+      count = saver->rest.count - saver->rest_next;
+      if (count > SAVE_BATCH_VECS) count = SAVE_BATCH_VECS;
+      if (!count) break;
+      saver->rest_next += count;
+    }
+
+    for (int i = 0; i < count; i++) saver->len += vec[i].len;
+    success = saverWrite(saver, vec, count);
+    if (reading) saverEndBatch(saver, success);
+  }
+  success = saverEnd(saver, success);
+
+  int error = errno;
+  if (fclose(saver->fp) != 0 && success) {
+    success = false;
+    error = errno;
+  }
+  if (saver->temp_path[0]) {
+    if (success && !replaceFile(saver->temp_path, saver->path)) {
+      success = false;
+      error = errno;
+    }
+    if (!success) remove(saver->temp_path);
+  }
+  if (success) editorWriteHistory(&saver->history, saver->path);
+
+  saver->success = success;
+  saver->error = error;
+  atomic_store(&saver->done, true);
+  wakeMainLoop();
+  return 0;
+}
+
+static void editorFreeSaver(EditorSaver* saver) {
+  mtx_destroy(&saver->mutex);
+  cnd_destroy(&saver->cond);
+  free(saver->batch.vec);
+  free(saver->rest.vec);
+  free(saver->text);
+  free(saver->buf);
+  free(saver);
+}
+
+static void editorFinishSave(EditorFile* file, EditorSaver* saver) {
+  file->saver = NULL;
+  if (saver->success) {
+    // Edits made during the save are still unsaved. Undoing and then
+    // editing brings dirty back to where it was, the text still differs.
+    file->dirty -= saver->dirty;
+    if (!file->dirty && file->revision != saver->revision) file->dirty = 1;
+    file->file_info = getFileInfo(file->filename);
+    editorJournalRebase(file, saver->journal_size);
+    editorMsg("%zu bytes written to disk.", saver->len);
+  } else {
+    editorMsg("Can't save \"%s\"! %s", file->filename,
+              strerror(saver->error));
+  }
+  editorFinishHistory(file, &saver->history);
+  editorFreeSaver(saver);
+}
+
+static void editorStartSave(EditorFile* file) {
+  EditorSaver* saver = calloc_s(1, sizeof(EditorSaver));
+  atomic_init(&saver->done, false);
+  snprintf(saver->path, sizeof(saver->path), "%s", file->filename);
+
+  // Write to a new file and rename it over the old one, which keeps the
+  // mapping the rows point into valid.
+  saver->fp = openTempFile(file->filename, saver->temp_path);
+  if (!saver->fp) {
+    saver->temp_path[0] = '\0';
+
+    // Can't create files in the directory, or the file has other names or
+    // an owner a new file wouldn't keep. Overwrite it in place. Truncating
+    // the file invalidates the mapping, so every row has to be moved to the
+    // heap first.
+    if (file->map.data) {
+      for (int i = 0; i < file->num_rows; i++) {
+        editorRowCopyOnWrite(file, editorGetRow(file, i));
+      }
+      unmapFile(&file->map);
+    }
+
+    saver->fp = openFile(file->filename, "wb");
+    if (!saver->fp) {
+      editorMsg("Can't save \"%s\"! %s", file->filename, strerror(errno));
+      free(saver);
+      return;
+    }
+  }
+
+  saver->map = file->map;
+  saver->compress = file->compress;
+  saver->encoding = file->encoding;
+  saver->dirty = file->dirty;
+  saver->revision = file->revision;
+  saver->journal_size = editorJournalSize(file);
+  editorPrepareHistory(file, &saver->history);
+
+  // The worker reads the rows as they are, without the gap
+  editorCloseRowGap(file, -1);
+  mtx_init(&saver->mutex, mtx_plain);
+  cnd_init(&saver->cond);
+  saver->rows = file->rows;
+  saver->num_rows = file->num_rows;
+  saver->nl = (file->newline == NL_DOS) ? "\r\n" : "\n";
+  saver->nl_len = strlen(saver->nl);
+  saver->batch.cap = SAVE_BATCH_VECS;
+  saver->batch.vec = malloc_s(sizeof(IOVec) * SAVE_BATCH_VECS);
+
+  if (thrd_create(&saver->thread, saverThread, saver) != thrd_success) {
+    saverThread(saver);
+    editorFinishSave(file, saver);
+    return;
+  }
+  file->saver = saver;
+}
+
+bool editorPollSave(EditorFile* file) {
+  EditorSaver* saver = file->saver;
+  if (!saver || !atomic_load(&saver->done)) return false;
+
+  thrd_join(saver->thread, NULL);
+  editorFinishSave(file, saver);
+  return true;
+}
+
+void editorWaitSave(EditorFile* file) {
+  EditorSaver* saver = file->saver;
+  if (!saver) return;
+
+  thrd_join(saver->thread, NULL);
+  editorFinishSave(file, saver);
+}
+
 void editorSave(EditorFile* file, int save_as) {
+  if (file->hex) {
+    editorMsg("Can't save in hex view.");
+    return;
+  }
+
+  if (file->loader) {
+    editorMsg("Can't save while the file is still loading.");
+    return;
+  }
+
+  if (file->saver) {
+    editorMsg("\"%s\" is still being saved.", getBaseName(file->filename));
+    return;
+  }
+
+  for (int i = 0; i < file->num_rows; i++) {
+    const EditorRow* row = editorGetRow(file, i);
+    if (!row->ascii && !canEncodeText(file->encoding, row->data, row->size)) {
+      editorMsg("Can't save, line %d has characters %s doesn't have.", i + 1,
+                getEncodingName(file->encoding));
+      return;
+    }
+  }
+
   if (!file->filename || save_as) {
     char* path = editorPrompt("Save as: %s", SAVE_AS_MODE, NULL);
     if (!path) {
@@ -177,8 +1392,8 @@ void editorSave(EditorFile* file, int save_as) {
       return;
     }
 
-    // Check path is valid
-    FILE* fp = openFile(path, "wb");
+    // Check path is valid, without truncating a file that might be mapped
+    FILE* fp = openFile(path, "ab");
     if (!fp) {
       editorMsg("Can't save \"%s\"! %s", path, strerror(errno));
       return;
@@ -192,22 +1407,7 @@ void editorSave(EditorFile* file, int save_as) {
     memcpy(file->filename, full_path, path_len);
   }
 
-  size_t len;
-  char* buf = editroRowsToString(file, &len);
-
-  FILE* fp = openFile(file->filename, "wb");
-  if (fp) {
-    if (fwrite(buf, sizeof(char), len, fp) == len) {
-      fclose(fp);
-      free(buf);
-      file->dirty = 0;
-      editorMsg("%d bytes written to disk.", len);
-      return;
-    }
-    fclose(fp);
-  }
-  free(buf);
-  editorMsg("Can't save \"%s\"! %s", file->filename, strerror(errno));
+  editorStartSave(file);
 }
 
 void editorOpenFilePrompt(void) {
@@ -231,3 +1431,171 @@ void editorOpenFilePrompt(void) {
 
   free(path);
 }
+
+// Follow mode
+
+void editorOpenStream(EditorFile* file, bool stream) {
+  editorInitFile(file);
+  editorInsertRow(file, 0, "", 0);
+  if (!stream) return;
+
+  file->follow = true;
+  file->stream = true;
+  editorMsg("Reading the input, press ^T to stop.");
+}
+
+static void editorStickToEnd(EditorFile* file) {
+  file->cursor.is_selected = false;
+  file->cursor.y = file->num_rows - 1;
+  file->cursor.x = 0;
+  file->sx = 0;
+  file->row_offset = file->num_rows - editor.display_rows;
+  if (file->row_offset < 0) file->row_offset = 0;
+}
+
+static void editorFollowAppend(EditorFile* file, const char* buf, size_t len) {
+  const char* end = buf + len;
+  while (buf < end) {
+    // The last row is the line that is still being written
+    EditorRow* row = editorGetRow(file, file->num_rows - 1);
+    const char* nl = memchr(buf, '\n', end - buf);
+    const char* line_end = nl ? nl : end;
+    editorRowAppendString(file, row, buf, line_end - buf);
+    if (!nl) break;
+
+    // \r might have come with the previous read
+    if (row->size > 0 && row->data[row->size - 1] == '\r') {
+      editorRowTruncate(file, row, row->size - 1);
+    }
+
+    editorInsertRow(file, file->num_rows, "", 0);
+    buf = nl + 1;
+  }
+}
+
+static void editorStopFollow(EditorFile* file, const char* reason) {
+  file->follow = false;
+  editorMsg("\"%s\" %s, stopped following it.", getBaseName(file->filename),
+            reason);
+}
+
+static void editorStopStream(EditorFile* file) {
+  closeInputStream();
+  file->follow = false;
+  file->stream = false;
+}
+
+// Piped input is read as it comes, without waiting for the end
+static bool editorPollStream(EditorFile* file) {
+  bool at_end = file->row_offset + editor.display_rows >= file->num_rows;
+
+  char buf[1 << 16];
+  int64_t total = 0;
+  int64_t n = 0;
+  while (total < EDITOR_FOLLOW_READ_SIZE &&
+         (n = readInputStream(buf, sizeof(buf))) > 0) {
+    editorFollowAppend(file, buf, n);
+    total += n;
+  }
+  if (n < 0) {
+    editorStopStream(file);
+    editorMsg("Finished reading the input.");
+  }
+  if (!total) return n < 0;
+
+  if (at_end) editorStickToEnd(file);
+  return true;
+}
+
+bool editorPollFollow(EditorFile* file) {
+  if (!file->follow) return false;
+  if (file->stream) return editorPollStream(file);
+
+  FileInfo info = getFileInfo(file->filename);
+  if (info.error || !areFilesEqual(info, file->file_info)) {
+    editorStopFollow(file, "was moved or deleted");
+    return true;
+  }
+
+  int64_t size = getFileSize(info);
+  if (size < file->follow_size) {
+    // Rows still pointing past the new end would fault on the next draw
+    if (file->map.data && (size_t)size < file->map.size) {
+      editorDetachMap(file, size);
+    }
+    editorStopFollow(file, "was truncated");
+    return true;
+  }
+  if (size == file->follow_size) return false;
+
+  FILE* fp = openFile(file->filename, "rb");
+  if (!fp || fseek(fp, file->follow_size, SEEK_SET) != 0) {
+    if (fp) fclose(fp);
+    editorStopFollow(file, "can't be read");
+    return true;
+  }
+
+  bool at_end = file->row_offset + editor.display_rows >= file->num_rows;
+
+  // Only read what's new, the rest of the buffer is kept as it is
+  char buf[1 << 16];
+  int64_t left = size - file->follow_size;
+  if (left > EDITOR_FOLLOW_READ_SIZE) left = EDITOR_FOLLOW_READ_SIZE;
+  while (left > 0) {
+    size_t n = sizeof(buf);
+    if ((int64_t)n > left) n = left;
+    n = fread(buf, 1, n, fp);
+    if (n == 0) break;
+    editorFollowAppend(file, buf, n);
+    file->follow_size += n;
+    left -= n;
+  }
+  fclose(fp);
+
+  // The buffer matches the file again
+  if (file->follow_size == size) file->file_info = info;
+
+  // Stay at the end unless scrolled away
+  if (at_end) editorStickToEnd(file);
+  return true;
+}
+
+void editorToggleFollow(EditorFile* file) {
+  if (file->stream) {
+    editorStopStream(file);
+    editorMsg("Stopped reading the input.");
+    return;
+  }
+
+  if (file->follow) {
+    file->follow = false;
+    editorMsg("Stopped following \"%s\".", getBaseName(file->filename));
+    return;
+  }
+
+  if (!file->filename) {
+    editorMsg("Only files on disk can be followed.");
+  } else if (file->loader) {
+    editorMsg("Can't follow while the file is still loading.");
+  } else if (file->saver) {
+    // Following can unmap the file the saver is still reading
+    editorMsg("Can't follow while the file is being saved.");
+  } else if (file->pager || file->hex) {
+    editorMsg("Can't follow in view mode.");
+  } else if (file->compress) {
+    editorMsg("Can't follow a compressed file.");
+  } else if (isTranscoded(file->encoding)) {
+    // Appended bytes would be shown without being decoded
+    editorMsg("Can't follow a file in %s.", getEncodingName(file->encoding));
+  } else if (file->dirty) {
+    editorMsg("Save the file before following it.");
+  } else {
+    // The buffer matches the file as it was when it was opened or saved
+    file->follow = true;
+    file->follow_size = getFileSize(file->file_info);
+    editorMsg("Following \"%s\", press ^T to stop.",
+              getBaseName(file->filename));
+    editorStickToEnd(file);
+    editorPollFollow(file);
+  }
+}
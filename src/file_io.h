@@ -6,10 +6,49 @@
 
 #include "utils.h"
 
+// Files larger than this only load the first screen before returning
+#define EDITOR_ASYNC_LOAD_SIZE (8 << 20)
+// Files larger than this are loaded on all cores
+#define EDITOR_PARALLEL_LOAD_SIZE (64 << 20)
+
 typedef struct EditorFile EditorFile;
+typedef struct EditorLoader EditorLoader;
+typedef struct EditorSaver EditorSaver;
 
 bool editorOpen(EditorFile* file, const char* filename);
+// Open read-only without loading every line
+bool editorOpenView(EditorFile* file, const char* filename);
+// Open files on all cores and add them in order, the first one is shown as
+// soon as it's ready
+void editorOpenFiles(char* const* paths, const bool* view, int count);
 void editorSave(EditorFile* file, int save_as);
 void editorOpenFilePrompt(void);
 
+// Background loading
+bool editorPollLoad(EditorFile* file);
+int editorLoadProgress(EditorFile* file);
+void editorCancelLoad(EditorFile* file);
+
+// Another program truncated the file. Rows still pointing into the mapping
+// are copied out, as much of them as is left, before they're read past its
+// new end.
+bool editorPollMap(EditorFile* file);
+
+// Follow mode
+// Most bytes read from a followed file between two screen updates
+#define EDITOR_FOLLOW_READ_SIZE (4 << 20)
+void editorToggleFollow(EditorFile* file);
+// Untitled buffer that follows the input piped to nino, or an empty one if
+// there's none
+void editorOpenStream(EditorFile* file, bool stream);
+bool editorPollFollow(EditorFile* file);
+
+// Background saving
+#define EDITOR_SAVING_LABEL " saving\xe2\x80\xa6"
+bool editorPollSave(EditorFile* file);
+void editorWaitSave(EditorFile* file);
+// Called before the file is edited, so a running save still writes the text
+// it started with
+void editorFreezeSave(EditorFile* file);
+
 #endif
@@ -0,0 +1,245 @@
+#include "hexview.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "editor.h"
+#include "input.h"
+#include "utils.h"
+
+bool isBinaryData(const char* data, size_t len) {
+  if (len > EDITOR_BINARY_SAMPLE_SIZE) len = EDITOR_BINARY_SAMPLE_SIZE;
+  return memchr(data, '\0', len) != NULL;
+}
+
+void editorStartHexView(EditorFile* file) {
+  file->hex = calloc_s(1, sizeof(EditorHexView));
+  editorFreeRows(file);
+  editorInsertRow(file, 0, "", 0);
+  file->lineno_width = 0;
+}
+
+void editorFreeHexView(EditorFile* file) {
+  free(file->hex);
+  file->hex = NULL;
+}
+
+static size_t hexLastByte(const EditorFile* file) {
+  return file->map.size ? file->map.size - 1 : 0;
+}
+
+int editorHexOffsetWidth(const EditorFile* file) {
+  int width = 8;
+  size_t last = hexLastByte(file);
+  while (width < 16 && (last >> (width * 4)) > 0) width++;
+  return width;
+}
+
+// A space, the offset, two spaces, the bytes in groups of 8, two spaces and
+// the ASCII column
+int editorHexColumn(const EditorFile* file, int bytes_per_row, int index,
+                    bool ascii) {
+  int hex_start = editorHexOffsetWidth(file) + 3;
+  if (!ascii) return hex_start + index * 3 + index / 8;
+  return hex_start + bytes_per_row * 3 + (bytes_per_row - 1) / 8 + 1 + index;
+}
+
+int editorHexBytesPerRow(const EditorFile* file) {
+  int bytes_per_row = 16;
+  while (bytes_per_row > 1 &&
+         editorHexColumn(file, bytes_per_row, bytes_per_row, true) >
+             editor.screen_cols) {
+    bytes_per_row /= 2;
+  }
+  return bytes_per_row;
+}
+
+static size_t hexMaxTop(const EditorFile* file, size_t bytes_per_row) {
+  size_t last = hexLastByte(file);
+  return last - last % bytes_per_row;
+}
+
+static void hexScroll(EditorFile* file, int64_t rows) {
+  EditorHexView* hex = file->hex;
+  size_t bytes_per_row = editorHexBytesPerRow(file);
+  size_t top = hex->top - hex->top % bytes_per_row;
+  size_t dist = (rows < 0 ? -rows : rows) * bytes_per_row;
+  size_t max_top = hexMaxTop(file, bytes_per_row);
+
+  if (rows < 0) {
+    top = (top > dist) ? top - dist : 0;
+  } else {
+    top = (max_top - top > dist) ? top + dist : max_top;
+  }
+  hex->top = top;
+}
+
+static void hexScrollToCursor(EditorFile* file) {
+  EditorHexView* hex = file->hex;
+  size_t bytes_per_row = editorHexBytesPerRow(file);
+  size_t row_start = hex->cursor - hex->cursor % bytes_per_row;
+  size_t page = bytes_per_row * editor.display_rows;
+
+  hex->top -= hex->top % bytes_per_row;
+  if (row_start < hex->top) hex->top = row_start;
+  if (row_start >= hex->top + page) {
+    hex->top = row_start - page + bytes_per_row;
+  }
+}
+
+static void hexScrollToCursorCenter(EditorFile* file) {
+  EditorHexView* hex = file->hex;
+  size_t bytes_per_row = editorHexBytesPerRow(file);
+  size_t row_start = hex->cursor - hex->cursor % bytes_per_row;
+  size_t half = bytes_per_row * (editor.display_rows / 2);
+  hex->top = (row_start > half) ? row_start - half : 0;
+}
+
+// Byte under a screen position, false if there isn't one
+static bool hexPosToOffset(const EditorFile* file, int x, int y,
+                           size_t* offset) {
+  int bytes_per_row = editorHexBytesPerRow(file);
+  size_t row_start = file->hex->top - file->hex->top % bytes_per_row;
+  row_start += (size_t)(y - 1) * bytes_per_row;
+
+  int index = -1;
+  int ascii_start = editorHexColumn(file, bytes_per_row, 0, true);
+  if (x >= ascii_start) {
+    index = x - ascii_start;
+  } else {
+    for (int i = bytes_per_row - 1; i >= 0; i--) {
+      if (x >= editorHexColumn(file, bytes_per_row, i, false)) {
+        index = i;
+        break;
+      }
+    }
+  }
+  if (index < 0 || index >= bytes_per_row) return false;
+  if (row_start + index >= file->map.size) return false;
+
+  *offset = row_start + index;
+  return true;
+}
+
+bool editorHexProcessKey(EditorFile* file, const EditorInput* input) {
+  EditorHexView* hex = file->hex;
+  size_t last = hexLastByte(file);
+  size_t bytes_per_row = editorHexBytesPerRow(file);
+  size_t page = bytes_per_row * editor.display_rows;
+  size_t column = hex->cursor % bytes_per_row;
+  int x = input->data.cursor.x;
+  int y = input->data.cursor.y;
+
+  bool should_scroll = true;
+  switch (input->type) {
+    case ARROW_LEFT:
+    case SHIFT_LEFT:
+      if (hex->cursor > 0) hex->cursor--;
+      break;
+
+    case ARROW_RIGHT:
+    case SHIFT_RIGHT:
+      if (hex->cursor < last) hex->cursor++;
+      break;
+
+    case ARROW_UP:
+    case SHIFT_UP:
+      if (hex->cursor >= bytes_per_row) hex->cursor -= bytes_per_row;
+      break;
+
+    case ARROW_DOWN:
+    case SHIFT_DOWN:
+      if (last - hex->cursor >= bytes_per_row) hex->cursor += bytes_per_row;
+      break;
+
+    case PAGE_UP:
+    case SHIFT_PAGE_UP:
+      hex->cursor = (hex->cursor >= page) ? hex->cursor - page : column;
+      hexScroll(file, -editor.display_rows);
+      break;
+
+    case PAGE_DOWN:
+    case SHIFT_PAGE_DOWN:
+      hex->cursor = (last - hex->cursor >= page) ? hex->cursor + page : last;
+      hexScroll(file, editor.display_rows);
+      break;
+
+    case HOME_KEY:
+    case SHIFT_HOME:
+      hex->cursor -= column;
+      break;
+
+    case END_KEY:
+    case SHIFT_END:
+      hex->cursor += bytes_per_row - 1 - column;
+      if (hex->cursor > last) hex->cursor = last;
+      break;
+
+    case CTRL_HOME:
+      hex->cursor = 0;
+      break;
+
+    case CTRL_END:
+      hex->cursor = last;
+      break;
+
+    case WHEEL_UP:
+    case WHEEL_DOWN: {
+      int field = getMousePosField(x, y);
+      if (field != FIELD_TEXT && field != FIELD_LINENO) return false;
+      should_scroll = false;
+      hexScroll(file, input->type == WHEEL_UP ? -3 : 3);
+    } break;
+
+    case CTRL_UP:
+    case CTRL_DOWN:
+      should_scroll = false;
+      hexScroll(file, input->type == CTRL_UP ? -1 : 1);
+      break;
+
+    case MOUSE_PRESSED: {
+      if (getMousePosField(x, y) != FIELD_TEXT) return false;
+      size_t offset;
+      if (hexPosToOffset(file, x, y, &offset)) hex->cursor = offset;
+    } break;
+
+    // There's nothing to select
+    case MOUSE_MOVE:
+    case MOUSE_RELEASED:
+      should_scroll = false;
+      break;
+
+    default:
+      return false;
+  }
+
+  if (should_scroll) hexScrollToCursor(file);
+  return true;
+}
+
+bool editorHexGoto(EditorFile* file, size_t offset) {
+  if (offset > hexLastByte(file)) return false;
+  file->hex->cursor = offset;
+  hexScrollToCursorCenter(file);
+  return true;
+}
+
+bool editorHexFind(EditorFile* file, const char* query, int direction) {
+  const char* map = file->map.data;
+  const char* end = map + file->map.size;
+  const char* cursor = map + file->hex->cursor;
+
+  const char* match;
+  if (direction < 0) {
+    match = strCaseStrBefore(map, cursor, end, query);
+  } else {
+    const char* from = (direction > 0 && cursor < end) ? cursor + 1 : cursor;
+    match = strCaseStr(from, end - from, query);
+  }
+  if (!match) return false;
+
+  file->hex->cursor = match - map;
+  hexScrollToCursorCenter(file);
+  return true;
+}
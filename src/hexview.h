@@ -0,0 +1,41 @@
+#ifndef HEXVIEW_H
+#define HEXVIEW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "terminal.h"
+
+// Bytes looked at for a NUL to tell binary files from text
+#define EDITOR_BINARY_SAMPLE_SIZE (64 << 10)
+
+typedef struct EditorFile EditorFile;
+
+// Binary files are shown as hex and ASCII read straight from the mapping.
+// Only the bytes on screen are ever touched, the file has a single empty
+// row so the rest of the editor still sees a valid buffer.
+typedef struct EditorHexView {
+  // Offset of the first byte on screen and of the cursor
+  size_t top;
+  size_t cursor;
+} EditorHexView;
+
+bool isBinaryData(const char* data, size_t len);
+
+void editorStartHexView(EditorFile* file);
+void editorFreeHexView(EditorFile* file);
+
+// Fits the screen width, 16 when there's room
+int editorHexBytesPerRow(const EditorFile* file);
+// Hex digits of the offset column
+int editorHexOffsetWidth(const EditorFile* file);
+// Screen column of a byte in the hex or the ASCII part of a row
+int editorHexColumn(const EditorFile* file, int bytes_per_row, int index,
+                    bool ascii);
+
+// Moving around, returns false for keys the hex view leaves to the editor
+bool editorHexProcessKey(EditorFile* file, const EditorInput* input);
+bool editorHexGoto(EditorFile* file, size_t offset);
+bool editorHexFind(EditorFile* file, const char* query, int direction);
+
+#endif
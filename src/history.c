@@ -0,0 +1,438 @@
+#include "history.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+#include "prompt.h"
+
+#define HISTORY_MAGIC "NINOUND\x01"
+#define HISTORY_MAGIC_SIZE 8
+// Longest header, the magic and three varints
+#define HISTORY_HEADER_MAX (HISTORY_MAGIC_SIZE + 3 * 10)
+
+// Every record ends with its size, so they can be read from the end
+#define HISTORY_SIZE_BYTES 4
+
+#define HISTORY_EDIT 'E'
+#define HISTORY_NEWLINE 'N'
+#define HISTORY_PATCH 'P'
+
+struct EditorHistory {
+  char path[EDITOR_PATH_MAX];
+  int64_t header_size;
+  // Bytes of records after the header that haven't been read yet
+  int64_t remaining;
+};
+
+static bool historyPath(const char* filename, char* path) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.und",
+           (unsigned long long)hashString(filename));
+  return getConfigPath(path, "undo", name);
+}
+
+static void historyAppendHeader(abuf* ab, FileStamp stamp) {
+  abufAppendN(ab, HISTORY_MAGIC, HISTORY_MAGIC_SIZE);
+  abufAppendVarint(ab, stamp.id);
+  abufAppendVarint(ab, (uint64_t)stamp.size);
+  abufAppendVarint(ab, (uint64_t)stamp.mtime);
+}
+
+static void appendRange(abuf* ab, EditorSelectRange range) {
+  abufAppendVarint(ab, range.start_x);
+  abufAppendVarint(ab, range.start_y);
+  abufAppendVarint(ab, range.end_x);
+  abufAppendVarint(ab, range.end_y);
+}
+
+static void appendCursor(abuf* ab, EditorCursor cursor) {
+  abufAppendVarint(ab, cursor.x);
+  abufAppendVarint(ab, cursor.y);
+  abufAppendVarint(ab, cursor.is_selected);
+  abufAppendVarint(ab, cursor.select_x);
+  abufAppendVarint(ab, cursor.select_y);
+}
+
+static void historyAppendAction(abuf* ab, const EditorAction* action) {
+  size_t start = ab->len;
+  switch (action->type) {
+    case ACTION_EDIT: {
+      const EditAction* edit = &action->edit;
+      abufAppendN(ab, &(char){HISTORY_EDIT}, 1);
+      appendRange(ab, edit->deleted_range);
+      abufAppendClipboard(ab, &edit->deleted_text);
+      appendRange(ab, edit->added_range);
+      abufAppendClipboard(ab, &edit->added_text);
+      appendCursor(ab, edit->old_cursor);
+      appendCursor(ab, edit->new_cursor);
+    } break;
+
+    case ACTION_ATTRI:
+      abufAppendN(ab, &(char){HISTORY_NEWLINE}, 1);
+      abufAppendVarint(ab, action->attri.old_newline);
+      abufAppendVarint(ab, action->attri.new_newline);
+      break;
+
+    case ACTION_PATCH: {
+      const PatchAction* patch = &action->patch;
+      abufAppendN(ab, &(char){HISTORY_PATCH}, 1);
+      abufAppendVarint(ab, patch->count);
+      for (int i = 0; i < patch->count; i++) {
+        abufAppendVarint(ab, patch->hunks[i].old_y);
+        abufAppendVarint(ab, patch->hunks[i].new_y);
+        abufAppendClipboard(ab, &patch->hunks[i].old_lines);
+        abufAppendClipboard(ab, &patch->hunks[i].new_lines);
+      }
+      abufAppendVarint(ab, patch->old_newline);
+      abufAppendVarint(ab, patch->new_newline);
+      appendCursor(ab, patch->old_cursor);
+      appendCursor(ab, patch->new_cursor);
+    } break;
+  }
+
+  uint32_t size = ab->len - start;
+  char bytes[HISTORY_SIZE_BYTES];
+  for (int i = 0; i < HISTORY_SIZE_BYTES; i++) {
+    bytes[i] = (size >> (i * 8)) & 0xFF;
+  }
+  abufAppendN(ab, bytes, HISTORY_SIZE_BYTES);
+}
+
+static bool readInt(const char** p, const char* end, int* n) {
+  uint64_t value;
+  if (!readVarint(p, end, &value) || value > INT32_MAX) return false;
+  *n = value;
+  return true;
+}
+
+static bool readRange(const char** p, const char* end,
+                      EditorSelectRange* range) {
+  return readInt(p, end, &range->start_x) &&
+         readInt(p, end, &range->start_y) && readInt(p, end, &range->end_x) &&
+         readInt(p, end, &range->end_y);
+}
+
+static bool readCursor(const char** p, const char* end, EditorCursor* cursor) {
+  int is_selected;
+  if (!readInt(p, end, &cursor->x) || !readInt(p, end, &cursor->y) ||
+      !readInt(p, end, &is_selected) || !readInt(p, end, &cursor->select_x) ||
+      !readInt(p, end, &cursor->select_y))
+    return false;
+  cursor->is_selected = is_selected;
+  return true;
+}
+
+static bool isValidNewline(int newline) {
+  return newline == NL_UNIX || newline == NL_DOS;
+}
+
+static bool readPatch(const char** p, const char* end, PatchAction* patch) {
+  uint64_t count;
+  // Every hunk takes at least four bytes
+  if (!readVarint(p, end, &count) || count > (uint64_t)(end - *p) / 4)
+    return false;
+
+  patch->hunks = calloc_s(count ? count : 1, sizeof(PatchHunk));
+  for (uint64_t i = 0; i < count; i++) {
+    PatchHunk* hunk = &patch->hunks[i];
+    if (!readInt(p, end, &hunk->old_y) || !readInt(p, end, &hunk->new_y) ||
+        !readClipboard(p, end, &hunk->old_lines))
+      return false;
+    // Counted once old_lines is read, so it's freed with the action
+    patch->count++;
+    if (!readClipboard(p, end, &hunk->new_lines)) return false;
+  }
+  return readInt(p, end, &patch->old_newline) &&
+         readInt(p, end, &patch->new_newline) &&
+         isValidNewline(patch->old_newline) &&
+         isValidNewline(patch->new_newline) &&
+         readCursor(p, end, &patch->old_cursor) &&
+         readCursor(p, end, &patch->new_cursor);
+}
+
+static EditorAction* historyReadAction(const char* p, const char* end) {
+  EditorAction* action = calloc_s(1, sizeof(EditorAction));
+  bool success = false;
+
+  switch (*p++) {
+    case HISTORY_EDIT: {
+      action->type = ACTION_EDIT;
+      EditAction* edit = &action->edit;
+      success = readRange(&p, end, &edit->deleted_range) &&
+                readClipboard(&p, end, &edit->deleted_text) &&
+                readRange(&p, end, &edit->added_range) &&
+                readClipboard(&p, end, &edit->added_text) &&
+                readCursor(&p, end, &edit->old_cursor) &&
+                readCursor(&p, end, &edit->new_cursor);
+    } break;
+
+    case HISTORY_NEWLINE: {
+      action->type = ACTION_ATTRI;
+      AttributeAction* attri = &action->attri;
+      success = readInt(&p, end, &attri->old_newline) &&
+                readInt(&p, end, &attri->new_newline) &&
+                isValidNewline(attri->old_newline) &&
+                isValidNewline(attri->new_newline);
+    } break;
+
+    case HISTORY_PATCH:
+      action->type = ACTION_PATCH;
+      success = readPatch(&p, end, &action->patch);
+      break;
+  }
+
+  if (!success || p != end) {
+    editorFreeAction(action);
+    return NULL;
+  }
+  return action;
+}
+
+void editorLoadHistory(EditorFile* file) {
+  if (!file->filename || file->pager || file->hex || file->history) return;
+
+  char path[EDITOR_PATH_MAX];
+  if (!historyPath(file->filename, path)) return;
+  FILE* fp = openFile(path, "rb");
+  if (!fp) return;
+
+  // Only the header is read until undo needs the records
+  char header[HISTORY_HEADER_MAX];
+  size_t len = fread(header, 1, sizeof(header), fp);
+  int64_t size = (fseek(fp, 0, SEEK_END) == 0) ? ftell(fp) : -1;
+  fclose(fp);
+
+  const char* p = header;
+  const char* end = header + len;
+  FileStamp stamp;
+  uint64_t stamp_size, stamp_mtime;
+  bool valid = len >= HISTORY_MAGIC_SIZE &&
+               memcmp(p, HISTORY_MAGIC, HISTORY_MAGIC_SIZE) == 0;
+  if (valid) {
+    p += HISTORY_MAGIC_SIZE;
+    valid = readVarint(&p, end, &stamp.id) &&
+            readVarint(&p, end, &stamp_size) &&
+            readVarint(&p, end, &stamp_mtime);
+  }
+  if (valid) {
+    stamp.size = stamp_size;
+    stamp.mtime = stamp_mtime;
+    valid = areStampsEqual(stamp, getFileStamp(file->file_info));
+  }
+
+  // The file was changed somewhere else, the history doesn't apply to it
+  if (!valid || size < p - header) {
+    remove(path);
+    return;
+  }
+
+  EditorHistory* history = calloc_s(1, sizeof(EditorHistory));
+  memcpy(history->path, path, sizeof(path));
+  history->header_size = p - header;
+  history->remaining = size - history->header_size;
+  file->history = history;
+}
+
+static bool historyRead(FILE* fp, int64_t offset, char* buf, size_t len) {
+  return fseek(fp, offset, SEEK_SET) == 0 && fread(buf, 1, len, fp) == len;
+}
+
+bool editorPageHistory(EditorFile* file) {
+  EditorHistory* history = file->history;
+  if (!history || !history->remaining) return false;
+
+  // The saver rewrites the file and its header, the offsets are only right
+  // again once the save is finished
+  if (file->saver) {
+    editorMsg("Older changes can be undone once \"%s\" is saved.",
+              getBaseName(file->filename));
+    return false;
+  }
+
+  FILE* fp = openFile(history->path, "rb");
+  if (!fp) {
+    history->remaining = 0;
+    return false;
+  }
+
+  // Read from the newest record back, each new node goes before the last one
+  EditorActionList* newest = NULL;
+  EditorActionList* oldest = NULL;
+  char* buf = NULL;
+  size_t buf_size = 0;
+  int count = 0;
+  while (count < EDITOR_HISTORY_PAGE_ACTIONS && history->remaining) {
+    int64_t end = history->header_size + history->remaining;
+    unsigned char bytes[HISTORY_SIZE_BYTES];
+    uint32_t size = 0;
+    bool valid = history->remaining > HISTORY_SIZE_BYTES &&
+                 historyRead(fp, end - HISTORY_SIZE_BYTES, (char*)bytes,
+                             HISTORY_SIZE_BYTES);
+    for (int i = 0; valid && i < HISTORY_SIZE_BYTES; i++) {
+      size |= (uint32_t)bytes[i] << (i * 8);
+    }
+    valid = valid && size > 0 &&
+            size <= history->remaining - HISTORY_SIZE_BYTES;
+
+    if (valid && size > buf_size) {
+      buf_size = size;
+      buf = realloc_s(buf, buf_size);
+    }
+    EditorAction* action =
+        valid && historyRead(fp, end - HISTORY_SIZE_BYTES - size, buf, size)
+            ? historyReadAction(buf, buf + size)
+            : NULL;
+    if (!action) {
+      // Nothing before a broken record can be used
+      history->remaining = 0;
+      break;
+    }
+
+    EditorActionList* node = malloc_s(sizeof(EditorActionList));
+    node->action = action;
+    node->prev = NULL;
+    node->next = oldest;
+    if (oldest) {
+      oldest->prev = node;
+    } else {
+      newest = node;
+    }
+    oldest = node;
+
+    history->remaining -= size + HISTORY_SIZE_BYTES;
+    count++;
+  }
+  free(buf);
+  fclose(fp);
+
+  if (!count) return false;
+
+  EditorActionList* head = file->action_head;
+  newest->next = head->next;
+  if (head->next) head->next->prev = newest;
+  head->next = oldest;
+  oldest->prev = head;
+  file->action_current = newest;
+  return true;
+}
+
+void editorFreeHistory(EditorFile* file) {
+  free(file->history);
+  file->history = NULL;
+}
+
+void editorPrepareHistory(EditorFile* file, HistoryWrite* write) {
+  write->success = false;
+  if (!historyPath(file->filename, write->path)) {
+    write->path[0] = '\0';
+    return;
+  }
+
+  EditorHistory* history = file->history;
+  if (history && history->remaining) {
+    memcpy(write->old_path, history->path, sizeof(history->path));
+    write->old_offset = history->header_size;
+    write->old_size = history->remaining;
+  }
+
+  // Redo isn't kept, the saved file is at the current action
+  EditorActionList* node = file->action_head;
+  while (node != file->action_current) {
+    node = node->next;
+    historyAppendAction(&write->records, node->action);
+  }
+}
+
+static bool historyCopy(FILE* to, const char* path, int64_t offset,
+                        int64_t size) {
+  FILE* fp = openFile(path, "rb");
+  if (!fp) return false;
+
+  char buf[1 << 16];
+  bool success = fseek(fp, offset, SEEK_SET) == 0;
+  while (success && size > 0) {
+    size_t n = sizeof(buf);
+    if ((int64_t)n > size) n = size;
+    success = fread(buf, 1, n, fp) == n && fwrite(buf, 1, n, to) == n;
+    size -= n;
+  }
+  fclose(fp);
+  return success;
+}
+
+// Keeps the newest old records that fit in size bytes
+static void historyTrim(HistoryWrite* write, int64_t size) {
+  int64_t kept = 0;
+  FILE* fp = size > 0 ? openFile(write->old_path, "rb") : NULL;
+  if (fp) {
+    int64_t end = write->old_offset + write->old_size;
+    while (kept + HISTORY_SIZE_BYTES < write->old_size) {
+      unsigned char bytes[HISTORY_SIZE_BYTES];
+      if (!historyRead(fp, end - kept - HISTORY_SIZE_BYTES, (char*)bytes,
+                       HISTORY_SIZE_BYTES))
+        break;
+      uint32_t record = 0;
+      for (int i = 0; i < HISTORY_SIZE_BYTES; i++) {
+        record |= (uint32_t)bytes[i] << (i * 8);
+      }
+      int64_t next = kept + record + HISTORY_SIZE_BYTES;
+      if (record == 0 || next > write->old_size || next > size) break;
+      kept = next;
+    }
+    fclose(fp);
+  }
+
+  write->old_offset += write->old_size - kept;
+  write->old_size = kept;
+}
+
+void editorWriteHistory(HistoryWrite* write, const char* saved_path) {
+  if (!write->path[0]) return;
+
+  // Nothing to undo
+  if (!write->records.len && !write->old_size) {
+    remove(write->path);
+    return;
+  }
+
+  FileInfo info = getFileInfo(saved_path);
+  if (info.error) return;
+
+  // Copying the old records costs the same on every save, so they're kept
+  // under a size
+  int64_t budget = EDITOR_HISTORY_MAX_SIZE - (int64_t)write->records.len;
+  if (write->old_size > budget) historyTrim(write, budget);
+
+  char temp_path[EDITOR_PATH_MAX];
+  FILE* fp = openTempFile(write->path, temp_path);
+  if (!fp) return;
+
+  abuf header = ABUF_INIT;
+  historyAppendHeader(&header, getFileStamp(info));
+  bool success =
+      fwrite(header.buf, 1, header.len, fp) == header.len &&
+      (!write->old_size || historyCopy(fp, write->old_path, write->old_offset,
+                                       write->old_size)) &&
+      fwrite(write->records.buf, 1, write->records.len, fp) ==
+          write->records.len;
+  success = (fclose(fp) == 0) && success;
+  if (success) success = replaceFile(temp_path, write->path);
+  if (!success) remove(temp_path);
+
+  write->header_size = header.len;
+  write->success = success;
+  abufFree(&header);
+}
+
+void editorFinishHistory(EditorFile* file, HistoryWrite* write) {
+  // Older records keep their offsets after the new header
+  EditorHistory* history = file->history;
+  if (write->success && history) {
+    memcpy(history->path, write->path, sizeof(write->path));
+    history->header_size = write->header_size;
+    history->remaining = write->old_size;
+  }
+  abufFree(&write->records);
+}
@@ -0,0 +1,46 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "os.h"
+#include "utils.h"
+
+// Undo records read from disk at a time
+#define EDITOR_HISTORY_PAGE_ACTIONS 64
+// Oldest records are dropped on save once the history is bigger than this
+#define EDITOR_HISTORY_MAX_SIZE (4 << 20)
+
+typedef struct EditorFile EditorFile;
+typedef struct EditorHistory EditorHistory;
+
+// Undo history written next to a save. It's taken on the main thread when
+// the save starts and written by the save worker once the file is replaced.
+typedef struct HistoryWrite {
+  char path[EDITOR_PATH_MAX];
+
+  // Older records that are still only on disk
+  char old_path[EDITOR_PATH_MAX];
+  int64_t old_offset;
+  int64_t old_size;
+
+  abuf records;
+
+  int64_t header_size;
+  bool success;
+} HistoryWrite;
+
+// The undo history is kept under CONF_DIR for every saved file, and comes
+// back when the same file is opened again. Records are only read when undo
+// gets to them.
+void editorLoadHistory(EditorFile* file);
+// Read the next page of older actions in front of the undo list
+bool editorPageHistory(EditorFile* file);
+void editorFreeHistory(EditorFile* file);
+
+void editorPrepareHistory(EditorFile* file, HistoryWrite* write);
+void editorWriteHistory(HistoryWrite* write, const char* saved_path);
+void editorFinishHistory(EditorFile* file, HistoryWrite* write);
+
+#endif
@@ -19,7 +19,7 @@ void editorScrollToCursor(void) {
   int cols = editor.screen_cols - current_file->lineno_width;
   int rx = 0;
   if (current_file->cursor.y < current_file->num_rows) {
-    rx = editorRowCxToRx(&current_file->row[current_file->cursor.y],
+    rx = editorRowCxToRx(editorPeekRow(current_file, current_file->cursor.y),
                          current_file->cursor.x);
   }
 
@@ -65,15 +65,18 @@ void mousePosToEditorPos(int* x, int* y) {
   }
   if (row >= current_file->num_rows) {
     *y = current_file->num_rows - 1;
-    *x = current_file->row[*y].rsize;
+    const EditorRow* last = editorGetRow(current_file, *y);
+    *x = editorRowCxToRx(last, last->size);
     return;
   }
 
   int col = *x - current_file->lineno_width + current_file->col_offset;
+  const EditorRow* curr = editorGetRow(current_file, row);
+  int width = editorRowCxToRx(curr, curr->size);
   if (col < 0) {
     col = 0;
-  } else if (col > current_file->row[row].rsize) {
-    col = current_file->row[row].rsize;
+  } else if (col > width) {
+    col = width;
   }
 
   *x = col;
@@ -91,28 +94,35 @@ void editorScroll(int dist) {
 }
 
 void editorMoveCursor(int key) {
-  const EditorRow* row = &current_file->row[current_file->cursor.y];
+  // Only sizes and widths are used, so the gap typing left stays open
+  const EditorRow* row = editorPeekRow(current_file, current_file->cursor.y);
   switch (key) {
     case ARROW_LEFT:
       if (current_file->cursor.x != 0) {
         current_file->cursor.x = editorRowPreviousUTF8(
-            &current_file->row[current_file->cursor.y], current_file->cursor.x);
+            editorPeekRow(current_file, current_file->cursor.y),
+            current_file->cursor.x);
         current_file->sx = editorRowCxToRx(
-            &current_file->row[current_file->cursor.y], current_file->cursor.x);
+            editorPeekRow(current_file, current_file->cursor.y),
+            current_file->cursor.x);
       } else if (current_file->cursor.y > 0) {
         current_file->cursor.y--;
-        current_file->cursor.x = current_file->row[current_file->cursor.y].size;
+        current_file->cursor.x =
+            editorPeekRow(current_file, current_file->cursor.y)->size;
         current_file->sx = editorRowCxToRx(
-            &current_file->row[current_file->cursor.y], current_file->cursor.x);
+            editorPeekRow(current_file, current_file->cursor.y),
+            current_file->cursor.x);
       }
       break;
 
     case ARROW_RIGHT:
       if (row && current_file->cursor.x < row->size) {
         current_file->cursor.x = editorRowNextUTF8(
-            &current_file->row[current_file->cursor.y], current_file->cursor.x);
+            editorPeekRow(current_file, current_file->cursor.y),
+            current_file->cursor.x);
         current_file->sx = editorRowCxToRx(
-            &current_file->row[current_file->cursor.y], current_file->cursor.x);
+            editorPeekRow(current_file, current_file->cursor.y),
+            current_file->cursor.x);
       } else if (row && (current_file->cursor.y + 1 < current_file->num_rows) &&
                  current_file->cursor.x == row->size) {
         current_file->cursor.y++;
@@ -125,7 +135,8 @@ void editorMoveCursor(int key) {
       if (current_file->cursor.y != 0) {
         current_file->cursor.y--;
         current_file->cursor.x = editorRowRxToCx(
-            &current_file->row[current_file->cursor.y], current_file->sx);
+            editorPeekRow(current_file, current_file->cursor.y),
+            current_file->sx);
       }
       break;
 
@@ -133,13 +144,14 @@ void editorMoveCursor(int key) {
       if (current_file->cursor.y + 1 < current_file->num_rows) {
         current_file->cursor.y++;
         current_file->cursor.x = editorRowRxToCx(
-            &current_file->row[current_file->cursor.y], current_file->sx);
+            editorPeekRow(current_file, current_file->cursor.y),
+            current_file->sx);
       }
       break;
   }
   row = (current_file->cursor.y >= current_file->num_rows)
             ? NULL
-            : &current_file->row[current_file->cursor.y];
+            : editorPeekRow(current_file, current_file->cursor.y);
   int row_len = row ? row->size : 0;
   if (current_file->cursor.x > row_len) {
     current_file->cursor.x = row_len;
@@ -168,30 +180,28 @@ static void editorMoveCursorWordLeft(void) {
     editorMoveCursor(ARROW_LEFT);
   }
 
-  const EditorRow* row = &current_file->row[current_file->cursor.y];
+  const EditorRow* row = editorGetRow(current_file, current_file->cursor.y);
   current_file->cursor.x =
       findPrevCharIndex(row, current_file->cursor.x, isIdentifierChar);
   current_file->cursor.x =
       findPrevCharIndex(row, current_file->cursor.x, isNonIdentifierChar);
-  current_file->sx = editorRowCxToRx(&current_file->row[current_file->cursor.y],
-                                     current_file->cursor.x);
+  current_file->sx = editorRowCxToRx(row, current_file->cursor.x);
 }
 
 static void editorMoveCursorWordRight(void) {
   if (current_file->cursor.x ==
-      current_file->row[current_file->cursor.y].size) {
+      editorGetRow(current_file, current_file->cursor.y)->size) {
     if (current_file->cursor.y == current_file->num_rows - 1) return;
     current_file->cursor.x = 0;
     current_file->cursor.y++;
   }
 
-  const EditorRow* row = &current_file->row[current_file->cursor.y];
+  const EditorRow* row = editorGetRow(current_file, current_file->cursor.y);
   current_file->cursor.x =
       findNextCharIndex(row, current_file->cursor.x, isIdentifierChar);
   current_file->cursor.x =
       findNextCharIndex(row, current_file->cursor.x, isNonIdentifierChar);
-  current_file->sx = editorRowCxToRx(&current_file->row[current_file->cursor.y],
-                                     current_file->cursor.x);
+  current_file->sx = editorRowCxToRx(row, current_file->cursor.x);
 }
 
 static void editorSelectWord(const EditorRow* row, int cx, IsCharFunc is_char) {
@@ -220,6 +230,7 @@ static int handleTabClick(int x) {
     int tab_width = strUTF8Width(filename) + 2;
 
     if (file->dirty) tab_width++;
+    if (file->saver) tab_width += strUTF8Width(EDITOR_SAVING_LABEL);
 
     if (editor.screen_cols - len < tab_width ||
         (i != editor.file_count - 1 && editor.screen_cols - len == tab_width)) {
@@ -245,12 +256,34 @@ static bool moveMouse(int x, int y) {
   if (getMousePosField(x, y) != FIELD_TEXT) return false;
   mousePosToEditorPos(&x, &y);
   current_file->cursor.is_selected = true;
-  current_file->cursor.x = editorRowRxToCx(&current_file->row[y], x);
+  current_file->cursor.x = editorRowRxToCx(editorGetRow(current_file, y), x);
   current_file->cursor.y = y;
   current_file->sx = x;
   return true;
 }
 
+static bool isEditingKey(int key) {
+  switch (key) {
+    case '\r':
+    case DEL_KEY:
+    case CTRL_KEY('h'):
+    case BACKSPACE:
+    case CTRL_KEY('x'):
+    case CTRL_KEY('v'):
+    case CTRL_KEY('z'):
+    case CTRL_KEY('y'):
+    case CTRL_KEY('n'):
+    case SHIFT_ALT_UP:
+    case SHIFT_ALT_DOWN:
+    case ALT_UP:
+    case ALT_DOWN:
+    case CHAR_INPUT:
+      return true;
+    default:
+      return false;
+  }
+}
+
 // Protect closing file with unsaved changes
 static int close_protect = -1;
 static void editorCloseFile(int index) {
@@ -259,6 +292,7 @@ static void editorCloseFile(int index) {
     return;
   }
 
+  editorWaitSave(&editor.files[index]);
   if (editor.files[index].dirty && close_protect != index) {
     editorMsg(
         "File has unsaved changes. Press again to close file "
@@ -272,6 +306,9 @@ static void editorCloseFile(int index) {
   if (index < editor.file_index ||
       (editor.file_index == index && index == editor.file_count)) {
     editorChangeToFile(editor.file_index - 1);
+  } else {
+    // The next tab took its place
+    editorChangeToFile(editor.file_index);
   }
 }
 
@@ -297,6 +334,38 @@ void editorProcessKeypress(void) {
 
   editorMsgClear();
 
+  if (current_file->loader && isEditingKey(input.type)) {
+    editorMsg("Can't edit while the file is still loading.");
+    return;
+  }
+
+  if (current_file->pager && isEditingKey(input.type)) {
+    editorMsg("Can't edit in view mode.");
+    return;
+  }
+
+  if (current_file->hex && isEditingKey(input.type)) {
+    editorMsg("Can't edit in hex view.");
+    return;
+  }
+
+  if (current_file->follow && isEditingKey(input.type)) {
+    editorMsg(current_file->stream
+                  ? "Can't edit while reading the input, press ^T to stop."
+                  : "Can't edit while following the file, press ^T to stop.");
+    return;
+  }
+
+  if (current_file->saver && isEditingKey(input.type)) {
+    editorFreezeSave(current_file);
+  }
+
+  if (current_file->hex && editorHexProcessKey(current_file, &input)) {
+    close_protect = -1;
+    quit_protect = true;
+    return;
+  }
+
   bool should_scroll = true;
 
   bool should_record_action = false;
@@ -335,6 +404,10 @@ void editorProcessKeypress(void) {
     case CTRL_KEY('q'): {
       close_protect = -1;
       editorFreeAction(action);
+      // Every save has to finish, not only the ones before a dirty file
+      for (int i = 0; i < editor.file_count; i++) {
+        editorWaitSave(&editor.files[i]);
+      }
       bool dirty = false;
       for (int i = 0; i < editor.file_count; i++) {
         if (editor.files[i].dirty) {
@@ -349,6 +422,11 @@ void editorProcessKeypress(void) {
         quit_protect = false;
         return;
       }
+      editorSaveSession();
+      // Unsaved changes are discarded, so their journals are too
+      for (int i = 0; i < editor.file_count; i++) {
+        editorFreeJournal(&editor.files[i]);
+      }
 #ifdef _DEBUG
       editorFree();
 #endif
@@ -371,9 +449,10 @@ void editorProcessKeypress(void) {
     // Save all
     case ALT_KEY(CTRL_KEY('s')):
       // Alt+Ctrl+S
+      // Every file is written by its own worker
       should_scroll = false;
       for (int i = 0; i < editor.file_count; i++) {
-        if (editor.files[i].dirty) {
+        if (editor.files[i].dirty && !editor.files[i].saver) {
           editorSave(&editor.files[i], 0);
         }
       }
@@ -388,11 +467,12 @@ void editorProcessKeypress(void) {
     case HOME_KEY:
     case SHIFT_HOME: {
       int start_x = findNextCharIndex(
-          &current_file->row[current_file->cursor.y], 0, isNonSpace);
+          editorGetRow(current_file, current_file->cursor.y), 0, isNonSpace);
       if (start_x == current_file->cursor.x) start_x = 0;
       current_file->cursor.x = start_x;
       current_file->sx =
-          editorRowCxToRx(&current_file->row[current_file->cursor.y], start_x);
+          editorRowCxToRx(editorGetRow(current_file, current_file->cursor.y),
+                          start_x);
       current_file->cursor.is_selected = (c == (SHIFT_HOME));
     } break;
 
@@ -400,10 +480,12 @@ void editorProcessKeypress(void) {
     case SHIFT_END:
       if (current_file->cursor.y < current_file->num_rows &&
           current_file->cursor.x !=
-              current_file->row[current_file->cursor.y].size) {
-        current_file->cursor.x = current_file->row[current_file->cursor.y].size;
+              editorGetRow(current_file, current_file->cursor.y)->size) {
+        current_file->cursor.x =
+            editorGetRow(current_file, current_file->cursor.y)->size;
         current_file->sx = editorRowCxToRx(
-            &current_file->row[current_file->cursor.y], current_file->cursor.x);
+            editorGetRow(current_file, current_file->cursor.y),
+            current_file->cursor.x);
         current_file->cursor.is_selected = (c == SHIFT_END);
       }
       break;
@@ -427,6 +509,18 @@ void editorProcessKeypress(void) {
       editorFind();
       break;
 
+    // Follow file
+    case CTRL_KEY('t'):
+      should_scroll = false;
+      editorToggleFollow(current_file);
+      break;
+
+    // Reload file
+    case CTRL_KEY('r'):
+      should_scroll = false;
+      editorReloadFile(current_file);
+      break;
+
     // Goto line
     case CTRL_KEY('g'):
       should_scroll = false;
@@ -436,13 +530,16 @@ void editorProcessKeypress(void) {
 
     case CTRL_KEY('a'):
     SELECT_ALL:
-      if (current_file->num_rows == 1 && current_file->row[0].size == 0) break;
+      if (current_file->num_rows == 1 &&
+          editorGetRow(current_file, 0)->size == 0)
+        break;
       current_file->cursor.is_selected = true;
       current_file->cursor.y = current_file->num_rows - 1;
       current_file->cursor.x =
-          current_file->row[current_file->num_rows - 1].size;
+          editorGetRow(current_file, current_file->num_rows - 1)->size;
       current_file->sx = editorRowCxToRx(
-          &current_file->row[current_file->cursor.y], current_file->cursor.x);
+          editorGetRow(current_file, current_file->cursor.y),
+          current_file->cursor.x);
       current_file->cursor.select_y = 0;
       current_file->cursor.select_x = 0;
 
@@ -457,7 +554,7 @@ void editorProcessKeypress(void) {
         if (c == DEL_KEY) {
           if (current_file->cursor.y == current_file->num_rows - 1 &&
               current_file->cursor.x ==
-                  current_file->row[current_file->num_rows - 1].size)
+                  editorPeekRow(current_file, current_file->num_rows - 1)->size)
             break;
         } else if (current_file->cursor.x == 0 && current_file->cursor.y == 0) {
           break;
@@ -489,7 +586,9 @@ void editorProcessKeypress(void) {
 
     // Action: Cut
     case CTRL_KEY('x'): {
-      if (current_file->num_rows == 1 && current_file->row[0].size == 0) break;
+      if (current_file->num_rows == 1 &&
+          editorGetRow(current_file, 0)->size == 0)
+        break;
 
       should_record_action = true;
       editorFreeClipboardContent(&editor.clipboard);
@@ -497,10 +596,11 @@ void editorProcessKeypress(void) {
       if (!current_file->cursor.is_selected) {
         // Copy line
         EditorSelectRange range = {
-            findNextCharIndex(&current_file->row[current_file->cursor.y], 0,
-                              isNonSpace),
+            findNextCharIndex(
+                editorGetRow(current_file, current_file->cursor.y), 0,
+                isNonSpace),
             current_file->cursor.y,
-            current_file->row[current_file->cursor.y].size,
+            editorGetRow(current_file, current_file->cursor.y)->size,
             current_file->cursor.y};
         editorCopyText(&editor.clipboard, range);
 
@@ -509,7 +609,7 @@ void editorProcessKeypress(void) {
         if (current_file->num_rows != 1) {
           if (current_file->cursor.y == current_file->num_rows - 1) {
             range.start_y--;
-            range.start_x = current_file->row[range.start_y].size;
+            range.start_x = editorGetRow(current_file, range.start_y)->size;
           } else {
             range.end_y++;
             range.end_x = 0;
@@ -540,10 +640,11 @@ void editorProcessKeypress(void) {
       } else {
         // Copy line
         EditorSelectRange range = {
-            findNextCharIndex(&current_file->row[current_file->cursor.y], 0,
-                              isNonSpace),
+            findNextCharIndex(
+                editorGetRow(current_file, current_file->cursor.y), 0,
+                isNonSpace),
             current_file->cursor.y,
-            current_file->row[current_file->cursor.y].size,
+            editorGetRow(current_file, current_file->cursor.y)->size,
             current_file->cursor.y};
         editorCopyText(&editor.clipboard, range);
       }
@@ -588,8 +689,9 @@ void editorProcessKeypress(void) {
 
     // Select word
     case CTRL_KEY('d'): {
-      const EditorRow* row = &current_file->row[current_file->cursor.y];
-      if (!isIdentifierChar(row->data[current_file->cursor.x])) {
+      const EditorRow* row = editorGetRow(current_file, current_file->cursor.y);
+      if (current_file->cursor.x >= row->size ||
+          !isIdentifierChar(row->data[current_file->cursor.x])) {
         should_scroll = false;
         break;
       }
@@ -645,7 +747,7 @@ void editorProcessKeypress(void) {
           } else {
             if (current_file->cursor.y == current_file->num_rows - 1) {
               current_file->cursor.x =
-                  current_file->row[current_file->cursor.y].size;
+                  editorGetRow(current_file, current_file->cursor.y)->size;
               break;
             }
             editorMoveCursor(ARROW_DOWN);
@@ -659,7 +761,7 @@ void editorProcessKeypress(void) {
       current_file->cursor.is_selected = (c == SHIFT_CTRL_PAGE_UP);
       while (current_file->cursor.y > 0) {
         editorMoveCursor(ARROW_UP);
-        if (current_file->row[current_file->cursor.y].size == 0) {
+        if (editorGetRow(current_file, current_file->cursor.y)->size == 0) {
           break;
         }
       }
@@ -670,7 +772,7 @@ void editorProcessKeypress(void) {
       current_file->cursor.is_selected = (c == SHIFT_CTRL_PAGE_DOWN);
       while (current_file->cursor.y < current_file->num_rows - 1) {
         editorMoveCursor(ARROW_DOWN);
-        if (current_file->row[current_file->cursor.y].size == 0) {
+        if (editorGetRow(current_file, current_file->cursor.y)->size == 0) {
           break;
         }
       }
@@ -692,7 +794,8 @@ void editorProcessKeypress(void) {
           current_file->cursor.y = range.end_y;
         }
         current_file->sx = editorRowCxToRx(
-            &current_file->row[current_file->cursor.y], current_file->cursor.x);
+            editorGetRow(current_file, current_file->cursor.y),
+            current_file->cursor.x);
         if (c == ARROW_UP || c == ARROW_DOWN) {
           editorMoveCursor(c);
         }
@@ -711,6 +814,7 @@ void editorProcessKeypress(void) {
       break;
 
     case CTRL_HOME:
+      if (current_file->pager) editorPagerSeekStart(current_file);
       current_file->cursor.is_selected = false;
       current_file->cursor.y = 0;
       current_file->cursor.x = 0;
@@ -718,12 +822,16 @@ void editorProcessKeypress(void) {
       break;
 
     case CTRL_END:
+      if (current_file->pager) editorPagerSeekEnd(current_file);
       current_file->cursor.is_selected = false;
+      // A streamed file can have no rows yet
+      if (current_file->num_rows == 0) break;
       current_file->cursor.y = current_file->num_rows - 1;
       current_file->cursor.x =
-          current_file->row[current_file->num_rows - 1].size;
+          editorGetRow(current_file, current_file->num_rows - 1)->size;
       current_file->sx = editorRowCxToRx(
-          &current_file->row[current_file->cursor.y], current_file->cursor.x);
+          editorGetRow(current_file, current_file->cursor.y),
+          current_file->cursor.x);
       break;
 
     // Action: Copy Line Up
@@ -734,14 +842,14 @@ void editorProcessKeypress(void) {
       current_file->cursor.is_selected = false;
       edit->old_cursor.is_selected = 0;
       editorInsertRow(current_file, current_file->cursor.y,
-                      current_file->row[current_file->cursor.y].data,
-                      current_file->row[current_file->cursor.y].size);
+                      editorGetRow(current_file, current_file->cursor.y)->data,
+                      editorGetRow(current_file, current_file->cursor.y)->size);
 
       edit->added_range.start_x =
-          current_file->row[current_file->cursor.y].size;
+          editorGetRow(current_file, current_file->cursor.y)->size;
       edit->added_range.start_y = current_file->cursor.y;
       edit->added_range.end_x =
-          current_file->row[current_file->cursor.y + 1].size;
+          editorGetRow(current_file, current_file->cursor.y + 1)->size;
       edit->added_range.end_y = current_file->cursor.y + 1;
       editorCopyText(&edit->added_text, edit->added_range);
 
@@ -771,7 +879,7 @@ void editorProcessKeypress(void) {
       int paste_x = 0;
       if (c == ALT_UP) {
         range.start_y--;
-        range.end_x = current_file->row[range.end_y].size;
+        range.end_x = editorGetRow(current_file, range.end_y)->size;
         editorCopyText(&edit->added_text, range);
         //  Move empty string at the start to the end
         char* temp = edit->added_text.data[0];
@@ -796,7 +904,7 @@ void editorProcessKeypress(void) {
         old_cy--;
         old_select_y--;
       } else {
-        paste_x = current_file->row[current_file->cursor.y].size;
+        paste_x = editorGetRow(current_file, current_file->cursor.y)->size;
         old_cy++;
         old_select_y++;
       }
@@ -841,7 +949,7 @@ void editorProcessKeypress(void) {
       curr_y = y;
 
       mousePosToEditorPos(&x, &y);
-      int cx = editorRowRxToCx(&current_file->row[y], x);
+      int cx = editorRowRxToCx(editorGetRow(current_file, y), x);
 
       switch (mouse_click % 4) {
         case 1:
@@ -853,7 +961,7 @@ void editorProcessKeypress(void) {
           break;
         case 2: {
           // Select word
-          const EditorRow* row = &current_file->row[y];
+          const EditorRow* row = editorGetRow(current_file, y);
           if (row->size == 0) break;
           if (cx == row->size) cx--;
 
@@ -871,10 +979,11 @@ void editorProcessKeypress(void) {
           // Select line
           if (current_file->cursor.y == current_file->num_rows - 1) {
             current_file->cursor.x =
-                current_file->row[current_file->cursor.y].size;
+                editorGetRow(current_file, current_file->cursor.y)->size;
             current_file->cursor.select_x = 0;
             current_file->sx =
-                editorRowCxToRx(&current_file->row[y], current_file->cursor.x);
+                editorRowCxToRx(editorGetRow(current_file, y),
+                                current_file->cursor.x);
           } else {
             current_file->cursor.x = 0;
             current_file->cursor.y++;
@@ -977,7 +1086,8 @@ void editorProcessKeypress(void) {
       editorCopyText(&edit->added_text, edit->added_range);
 
       current_file->sx = editorRowCxToRx(
-          &current_file->row[current_file->cursor.y], current_file->cursor.x);
+          editorPeekRow(current_file, current_file->cursor.y),
+          current_file->cursor.x);
       current_file->cursor.is_selected = false;
 
       if (x_offset == -1) {
@@ -1010,6 +1120,8 @@ void editorProcessKeypress(void) {
   }
 
   if (should_scroll) editorScrollToCursor();
+  editorPagerSlide(current_file);
+  editorCloseRowGap(current_file, current_file->cursor.y);
   close_protect = -1;
   quit_protect = true;
 }
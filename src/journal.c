@@ -0,0 +1,428 @@
+#include "journal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+#include "os.h"
+#include "prompt.h"
+#include "utils.h"
+
+#define JOURNAL_MAGIC "NINOJNL\x01"
+#define JOURNAL_MAGIC_SIZE 8
+
+// Delete deleted range, then insert lines at x, y
+#define JOURNAL_EDIT 'E'
+// Change the newline type
+#define JOURNAL_NEWLINE 'N'
+// Replace a number of rows at y with lines
+#define JOURNAL_LINES 'L'
+
+struct EditorJournal {
+  FILE* fp;
+  char path[EDITOR_PATH_MAX];
+
+  // Bytes of changes after the header
+  int64_t size;
+  int64_t header_size;
+
+  bool pending;
+  int64_t last_flush;
+};
+
+static bool journalPath(const char* filename, char* path) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.jnl",
+           (unsigned long long)hashString(filename));
+  return getConfigPath(path, "journal", name);
+}
+
+static void journalAppendHeader(abuf* ab, FileStamp stamp) {
+  abufAppendN(ab, JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE);
+  abufAppendVarint(ab, stamp.id);
+  abufAppendVarint(ab, (uint64_t)stamp.size);
+  abufAppendVarint(ab, (uint64_t)stamp.mtime);
+}
+
+static bool journalReadHeader(const char** p, const char* end,
+                              FileStamp* stamp) {
+  if (end - *p < JOURNAL_MAGIC_SIZE ||
+      memcmp(*p, JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE) != 0)
+    return false;
+  *p += JOURNAL_MAGIC_SIZE;
+
+  uint64_t size, mtime;
+  if (!readVarint(p, end, &stamp->id) || !readVarint(p, end, &size) ||
+      !readVarint(p, end, &mtime))
+    return false;
+  stamp->size = (int64_t)size;
+  stamp->mtime = (int64_t)mtime;
+  return true;
+}
+
+static void journalClose(EditorJournal* journal, bool delete_file) {
+  if (journal->fp) {
+    fclose(journal->fp);
+    if (delete_file) remove(journal->path);
+  }
+  free(journal);
+}
+
+// Create the journal on the first change, against the file as it is on disk
+static EditorJournal* editorGetJournal(EditorFile* file) {
+  if (file->journal) return file->journal->fp ? file->journal : NULL;
+  if (!file->filename || file->pager || file->hex) return NULL;
+
+  // Stays without a file if it can't be created, so it's not retried on
+  // every change
+  EditorJournal* journal = calloc_s(1, sizeof(EditorJournal));
+  file->journal = journal;
+  if (!journalPath(file->filename, journal->path)) return NULL;
+
+  journal->fp = openFile(journal->path, "wb");
+  if (!journal->fp) return NULL;
+
+  abuf ab = ABUF_INIT;
+  journalAppendHeader(&ab, getFileStamp(file->file_info));
+  if (fwrite(ab.buf, 1, ab.len, journal->fp) != ab.len) {
+    fclose(journal->fp);
+    remove(journal->path);
+    journal->fp = NULL;
+  }
+  journal->header_size = ab.len;
+  journal->last_flush = getTime();
+  abufFree(&ab);
+  return journal->fp ? journal : NULL;
+}
+
+static void journalWrite(EditorFile* file, abuf* ab) {
+  EditorJournal* journal = editorGetJournal(file);
+  if (journal) {
+    if (fwrite(ab->buf, 1, ab->len, journal->fp) == ab->len) {
+      journal->size += ab->len;
+      journal->pending = true;
+    } else {
+      fclose(journal->fp);
+      remove(journal->path);
+      journal->fp = NULL;
+    }
+  }
+  abufFree(ab);
+}
+
+void editorJournalEdit(EditorFile* file, EditorSelectRange deleted,
+                       const EditorClipboard* added, int x, int y) {
+  abuf ab = ABUF_INIT;
+  abufAppendN(&ab, &(char){JOURNAL_EDIT}, 1);
+  abufAppendVarint(&ab, deleted.start_x);
+  abufAppendVarint(&ab, deleted.start_y);
+  abufAppendVarint(&ab, deleted.end_x);
+  abufAppendVarint(&ab, deleted.end_y);
+  abufAppendVarint(&ab, x);
+  abufAppendVarint(&ab, y);
+  abufAppendClipboard(&ab, added);
+  journalWrite(file, &ab);
+}
+
+void editorJournalNewline(EditorFile* file, int newline) {
+  abuf ab = ABUF_INIT;
+  abufAppendN(&ab, &(char){JOURNAL_NEWLINE}, 1);
+  abufAppendVarint(&ab, newline);
+  journalWrite(file, &ab);
+}
+
+void editorJournalPatch(EditorFile* file, const PatchAction* patch,
+                        bool undo) {
+  // Replayed one hunk at a time, so each one starts where it is once the
+  // hunks before it are done
+  for (int i = 0; i < patch->count; i++) {
+    const PatchHunk* hunk = &patch->hunks[i];
+    const EditorClipboard* from = undo ? &hunk->new_lines : &hunk->old_lines;
+    const EditorClipboard* to = undo ? &hunk->old_lines : &hunk->new_lines;
+
+    abuf ab = ABUF_INIT;
+    abufAppendN(&ab, &(char){JOURNAL_LINES}, 1);
+    abufAppendVarint(&ab, undo ? hunk->old_y : hunk->new_y);
+    abufAppendVarint(&ab, from->size);
+    abufAppendClipboard(&ab, to);
+    journalWrite(file, &ab);
+  }
+
+  if (patch->old_newline != patch->new_newline) {
+    editorJournalNewline(file,
+                         undo ? patch->old_newline : patch->new_newline);
+  }
+}
+
+void editorPollJournal(EditorFile* file) {
+  EditorJournal* journal = file->journal;
+  if (!journal || !journal->pending) return;
+
+  // Batch the changes instead of writing every key press
+  int64_t time = getTime();
+  if (time - journal->last_flush < EDITOR_JOURNAL_FLUSH_INTERVAL * 1000)
+    return;
+
+  fflush(journal->fp);
+  journal->pending = false;
+  journal->last_flush = time;
+}
+
+int64_t editorJournalSize(EditorFile* file) {
+  return file->journal ? file->journal->size : 0;
+}
+
+void editorJournalRebase(EditorFile* file, int64_t saved_size) {
+  EditorJournal* journal = file->journal;
+  if (!journal) return;
+
+  if (!journal->fp || saved_size >= journal->size) {
+    editorFreeJournal(file);
+    return;
+  }
+
+  // Changes made during the save are kept, on top of the saved file
+  fflush(journal->fp);
+  size_t len = journal->size - saved_size;
+  char* changes = malloc_s(len);
+  FILE* fp = openFile(journal->path, "rb");
+  bool success = fp &&
+                 fseek(fp, journal->header_size + saved_size, SEEK_SET) == 0 &&
+                 fread(changes, 1, len, fp) == len;
+  if (fp) fclose(fp);
+
+  char temp_path[EDITOR_PATH_MAX];
+  FILE* new_fp = success ? openTempFile(journal->path, temp_path) : NULL;
+  if (new_fp) {
+    abuf ab = ABUF_INIT;
+    journalAppendHeader(&ab, getFileStamp(file->file_info));
+    success = fwrite(ab.buf, 1, ab.len, new_fp) == ab.len &&
+              fwrite(changes, 1, len, new_fp) == len &&
+              fflush(new_fp) == 0 && replaceFile(temp_path, journal->path);
+    journal->header_size = ab.len;
+    abufFree(&ab);
+  } else {
+    success = false;
+  }
+  free(changes);
+
+  fclose(journal->fp);
+  journal->fp = NULL;
+  if (!success) {
+    if (new_fp) {
+      fclose(new_fp);
+      remove(temp_path);
+    }
+    remove(journal->path);
+    return;
+  }
+
+  journal->fp = new_fp;
+  journal->size = len;
+  journal->pending = false;
+}
+
+void editorFreeJournal(EditorFile* file) {
+  if (!file->journal) return;
+  journalClose(file->journal, true);
+  file->journal = NULL;
+}
+
+// Replay
+
+static bool isValidPos(int x, int y) {
+  return y >= 0 && y < current_file->num_rows && x >= 0 &&
+         x <= editorGetRow(current_file, y)->size;
+}
+
+static bool replayEdit(const char** p, const char* end) {
+  uint64_t values[6];
+  for (int i = 0; i < 6; i++) {
+    if (!readVarint(p, end, &values[i]) || values[i] > INT32_MAX) return false;
+  }
+
+  EditorSelectRange range = {values[0], values[1], values[2], values[3]};
+  int x = values[4];
+  int y = values[5];
+  if (!isValidPos(range.start_x, range.start_y) ||
+      !isValidPos(range.end_x, range.end_y) || range.start_y > range.end_y ||
+      (range.start_y == range.end_y && range.start_x > range.end_x))
+    return false;
+
+  EditorClipboard text;
+  if (!readClipboard(p, end, &text)) return false;
+
+  // Same as an edit made from the keyboard, so it can be undone
+  EditorAction* action = calloc_s(1, sizeof(EditorAction));
+  action->type = ACTION_EDIT;
+  EditAction* edit = &action->edit;
+  edit->old_cursor = current_file->cursor;
+
+  edit->deleted_range = range;
+  editorCopyText(&edit->deleted_text, range);
+  editorDeleteText(range);
+
+  if (!isValidPos(x, y)) {
+    editorPasteText(&edit->deleted_text, range.start_x, range.start_y);
+    editorFreeAction(action);
+    editorFreeClipboardContent(&text);
+    return false;
+  }
+
+  current_file->cursor.x = x;
+  current_file->cursor.y = y;
+  editorPasteText(&text, x, y);
+  edit->added_range.start_x = x;
+  edit->added_range.start_y = y;
+  edit->added_range.end_x = current_file->cursor.x;
+  edit->added_range.end_y = current_file->cursor.y;
+  edit->added_text = text;
+  edit->new_cursor = current_file->cursor;
+
+  editorAppendAction(action);
+  return true;
+}
+
+static bool replayNewline(const char** p, const char* end) {
+  uint64_t newline;
+  if (!readVarint(p, end, &newline) || (newline != NL_UNIX && newline != NL_DOS))
+    return false;
+
+  EditorAction* action = calloc_s(1, sizeof(EditorAction));
+  action->type = ACTION_ATTRI;
+  action->attri.old_newline = current_file->newline;
+  action->attri.new_newline = newline;
+  current_file->newline = newline;
+  editorAppendAction(action);
+  return true;
+}
+
+static bool replayLines(const char** p, const char* end) {
+  uint64_t y, count;
+  if (!readVarint(p, end, &y) || !readVarint(p, end, &count) ||
+      y > (uint64_t)current_file->num_rows ||
+      count > (uint64_t)current_file->num_rows - y)
+    return false;
+
+  EditorClipboard lines;
+  if (!readClipboard(p, end, &lines)) return false;
+
+  // There's always a row left
+  if ((uint64_t)current_file->num_rows - count + lines.size == 0) {
+    editorFreeClipboardContent(&lines);
+    return false;
+  }
+
+  // Same as a reload, so it can be undone
+  EditorAction* action = calloc_s(1, sizeof(EditorAction));
+  action->type = ACTION_PATCH;
+  PatchAction* patch = &action->patch;
+  patch->count = 1;
+  patch->hunks = calloc_s(1, sizeof(PatchHunk));
+  patch->hunks[0].old_y = y;
+  patch->hunks[0].new_y = y;
+  editorCopyRows(&patch->hunks[0].old_lines, current_file, y, count);
+  patch->hunks[0].new_lines = lines;
+  patch->old_newline = current_file->newline;
+  patch->new_newline = current_file->newline;
+  patch->old_cursor = current_file->cursor;
+
+  editorApplyPatch(current_file, patch, false);
+  current_file->cursor = (EditorCursor){0};
+  current_file->cursor.y =
+      ((int)y < current_file->num_rows) ? (int)y : current_file->num_rows - 1;
+  current_file->cursor.select_y = current_file->cursor.y;
+  patch->new_cursor = current_file->cursor;
+
+  editorAppendAction(action);
+  return true;
+}
+
+void editorRecoverJournal(EditorFile* file) {
+  if (!file->filename || file->pager || file->hex || file->journal)
+    return;
+
+  char path[EDITOR_PATH_MAX];
+  if (!journalPath(file->filename, path)) return;
+  FILE* fp = openFile(path, "rb");
+  if (!fp) return;
+
+  abuf ab = ABUF_INIT;
+  char buf[1 << 16];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    abufAppendN(&ab, buf, n);
+  }
+  fclose(fp);
+
+  const char* p = ab.buf;
+  const char* end = ab.buf + ab.len;
+  FileStamp stamp;
+  if (!journalReadHeader(&p, end, &stamp)) {
+    abufFree(&ab);
+    remove(path);
+    return;
+  }
+
+  // The changes can't be replayed on other text, they're moved aside so the
+  // next change doesn't overwrite them
+  if (!areStampsEqual(stamp, getFileStamp(file->file_info))) {
+    char old_path[EDITOR_PATH_MAX + 4];
+    snprintf(old_path, sizeof(old_path), "%s.old", path);
+    if (replaceFile(path, old_path)) {
+      editorMsg("\"%s\" changed since it crashed, its unsaved changes were "
+                "kept in %s.",
+                getBaseName(file->filename), old_path);
+    } else {
+      editorMsg("\"%s\" changed since it crashed, its unsaved changes can't "
+                "be replayed.",
+                getBaseName(file->filename));
+    }
+    abufFree(&ab);
+    return;
+  }
+
+  // Editing functions work on current_file. Replayed changes are journaled
+  // again, which replaces the old journal.
+  EditorFile* prev_file = current_file;
+  current_file = file;
+  EditorCursor cursor = file->cursor;
+
+  int count = 0;
+  bool success = true;
+  while (p < end && success) {
+    char type = *p++;
+    switch (type) {
+      case JOURNAL_EDIT:
+        success = replayEdit(&p, end);
+        break;
+      case JOURNAL_NEWLINE:
+        success = replayNewline(&p, end);
+        break;
+      case JOURNAL_LINES:
+        success = replayLines(&p, end);
+        break;
+      default:
+        success = false;
+        break;
+    }
+    if (success) count++;
+  }
+
+  if (count) {
+    file->cursor.is_selected = false;
+    file->cursor.select_x = file->cursor.x;
+    file->cursor.select_y = file->cursor.y;
+  } else {
+    file->cursor = cursor;
+    remove(path);
+  }
+  current_file = prev_file;
+  abufFree(&ab);
+
+  if (count) {
+    editorMsg("Recovered %d unsaved changes to \"%s\", ^Z undoes them.", count,
+              getBaseName(file->filename));
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "action.h"
+#include "select.h"
+
+// Journaled changes are written to disk at least this often (ms)
+#define EDITOR_JOURNAL_FLUSH_INTERVAL 1000
+
+typedef struct EditorFile EditorFile;
+typedef struct EditorJournal EditorJournal;
+
+// Every change made to a buffer since it was last saved is appended to a
+// journal under CONF_DIR, so it can be replayed on the file after a crash.
+void editorJournalEdit(EditorFile* file, EditorSelectRange deleted,
+                       const EditorClipboard* added, int x, int y);
+void editorJournalNewline(EditorFile* file, int newline);
+void editorJournalPatch(EditorFile* file, const PatchAction* patch, bool undo);
+void editorPollJournal(EditorFile* file);
+
+// Size of the changes in the journal, used to drop the ones that got saved
+int64_t editorJournalSize(EditorFile* file);
+void editorJournalRebase(EditorFile* file, int64_t saved_size);
+
+void editorRecoverJournal(EditorFile* file);
+// Also deletes the journal
+void editorFreeJournal(EditorFile* file);
+
+#endif
@@ -9,25 +9,52 @@
 #include "row.h"
 
 int main(int argc, char* argv[]) {
+  Args cmd_args = argsGet(argc, argv);
+
+  // "-" reads what's piped in, before the terminal takes over stdin
+  bool has_stream = false;
+  bool stream = false;
+  for (int i = 1; i < cmd_args.count; i++) {
+    if (strcmp(cmd_args.args[i], "-") == 0) {
+      has_stream = true;
+      stream = openInputStream();
+      break;
+    }
+  }
+
   editorInit();
   EditorFile file;
   editorInitFile(&file);
 
-  Args cmd_args = argsGet(argc, argv);
+  if (has_stream) {
+    editorOpenStream(&file, stream);
+    editorAddFile(&file);
+  }
 
   if (cmd_args.count > 1) {
+    // Files after --view are opened read-only
+    char** paths = malloc_s(sizeof(char*) * cmd_args.count);
+    bool* views = malloc_s(sizeof(bool) * cmd_args.count);
+    int count = 0;
+    bool view = false;
     for (int i = 1; i < cmd_args.count; i++) {
-      if (editor.file_count >= EDITOR_FILE_MAX_SLOT) {
-        editorMsg("Already opened too many files!");
-        break;
-      }
-      editorInitFile(&file);
-      if (editorOpen(&file, cmd_args.args[i])) {
-        editorAddFile(&file);
+      if (strcmp(cmd_args.args[i], "--view") == 0) {
+        view = true;
+        continue;
       }
+      if (strcmp(cmd_args.args[i], "-") == 0) continue;
+      paths[count] = cmd_args.args[i];
+      views[count] = view;
+      count++;
     }
+    editorOpenFiles(paths, views, count);
+    free(paths);
+    free(views);
   }
 
+  // Without files, pick up where the last session left off
+  if (cmd_args.count <= 1) editorRestoreSession();
+
   argsFree(cmd_args);
 
   if (editor.file_count == 0) {
@@ -41,6 +68,7 @@ int main(int argc, char* argv[]) {
     editorRefreshScreen();
     editorProcessKeypress();
   }
+  editorSaveSession();
   editorFree();
   return 0;
 }
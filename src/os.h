@@ -9,6 +9,16 @@
 typedef struct FileInfo FileInfo;
 FileInfo getFileInfo(const char* path);
 bool areFilesEqual(FileInfo f1, FileInfo f2);
+int64_t getFileSize(FileInfo info);
+
+// Identifies a version of a file on disk
+typedef struct FileStamp {
+  uint64_t id;
+  int64_t size;
+  int64_t mtime;
+} FileStamp;
+FileStamp getFileStamp(FileInfo info);
+bool areStampsEqual(FileStamp s1, FileStamp s2);
 
 typedef enum FileType {
   FT_INVALID = -1,
@@ -25,12 +35,70 @@ void dirClose(DirIter* iter);
 const char* dirGetName(const DirIter* iter);
 
 FILE* openFile(const char* path, const char* mode);
+
+// Read-only private mapping of a whole file
+typedef struct FileMap FileMap;
+bool mapFile(FileMap* map, FILE* fp);
+void unmapFile(FileMap* map);
+// Size of the file on disk now, -1 if it can't be found out. Smaller than
+// the mapping when another program truncated it.
+int64_t getMapFileSize(const FileMap* map);
+// Reading past the end of a truncated file faults. Puts a page of zeros at
+// addr instead, safe to call from a signal handler.
+bool mapZeroPage(void* addr);
+
+// Saving
+typedef struct IOVec {
+  const char* data;
+  size_t len;
+} IOVec;
+
+// Write a range of the mapped file at offset to, in the kernel if possible
+bool writeFileFromMap(FILE* fp, int64_t to, const FileMap* map,
+                      size_t offset, size_t len);
+// Create an empty file next to path with the same permissions. Fails when it
+// can't take the place of path without losing its links or owner.
+FILE* openTempFile(const char* path, char* temp_path);
+bool replaceFile(const char* from, const char* to);
+
+// Asynchronous I/O, with many requests in flight at once
+typedef struct AsyncIO AsyncIO;
+AsyncIO* asyncInit(int depth);
+// Blocks only while depth requests are already in flight
+bool asyncWrite(AsyncIO* aio, FILE* fp, const IOVec* vec, int count,
+                int64_t offset);
+// Start reading a range of the mapped file into the page cache
+void asyncReadahead(AsyncIO* aio, const FileMap* map, size_t offset,
+                    size_t len);
+// Wait for every request, false with errno set if a write failed
+bool asyncWait(AsyncIO* aio);
+void asyncFree(AsyncIO* aio);
+
+// Makes waitForInput return early, from any thread
+void wakeMainLoop(void);
+// Wait up to timeout ms, returns true if there's input to read
+bool waitForInput(int timeout);
+
+// Input piped to nino. The keyboard is read from the terminal instead, and
+// new data wakes waitForInput up.
+bool openInputStream(void);
+// Bytes read, 0 if nothing came yet, -1 at the end
+int64_t readInputStream(char* buf, size_t len);
+void closeInputStream(void);
+
 bool changeDir(const char* path);
+// Path of a file in a directory under CONF_DIR, which is created if needed
+bool getConfigPath(char* path, const char* dir, const char* name);
 char* getFullPath(const char* path);
 
 // Time
 int64_t getTime(void);
 
+// Number of online processors
+int getCpuCount(void);
+// Physical memory in bytes
+uint64_t getMemorySize(void);
+
 // Command line
 typedef struct Args {
   int count;
@@ -2,8 +2,18 @@
 
 #include "os_unix.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <threads.h>
 
 #include "os.h"
 #include "utils.h"
@@ -15,7 +25,23 @@ FileInfo getFileInfo(const char* path) {
 }
 
 bool areFilesEqual(FileInfo f1, FileInfo f2) {
-  return f1.info.st_ino == f2.info.st_ino;
+  return !f1.error && !f2.error && f1.info.st_ino == f2.info.st_ino;
+}
+
+int64_t getFileSize(FileInfo info) { return info.info.st_size; }
+
+FileStamp getFileStamp(FileInfo info) {
+  FileStamp stamp = {0};
+  if (info.error) return stamp;
+  stamp.id = info.info.st_ino;
+  stamp.size = info.info.st_size;
+  stamp.mtime = (int64_t)info.info.st_mtim.tv_sec * 1000000000 +
+                info.info.st_mtim.tv_nsec;
+  return stamp;
+}
+
+bool areStampsEqual(FileStamp s1, FileStamp s2) {
+  return s1.id == s2.id && s1.size == s2.size && s1.mtime == s2.mtime;
 }
 
 FileType getFileType(const char* path) {
@@ -57,8 +83,630 @@ const char* dirGetName(const DirIter* iter) {
 
 FILE* openFile(const char* path, const char* mode) { return fopen(path, mode); }
 
+bool mapFile(FileMap* map, FILE* fp) {
+  map->data = NULL;
+  map->size = 0;
+
+  struct stat info;
+  if (fstat(fileno(fp), &info) == -1 || info.st_size <= 0) return false;
+
+  void* data =
+      mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+  if (data == MAP_FAILED) return false;
+
+  map->data = data;
+  map->size = info.st_size;
+  // Kept to copy unchanged ranges in the kernel when saving
+  map->fd = fcntl(fileno(fp), F_DUPFD_CLOEXEC, 0);
+  return true;
+}
+
+void unmapFile(FileMap* map) {
+  if (!map->data) return;
+  munmap(map->data, map->size);
+  if (map->fd != -1) close(map->fd);
+  map->data = NULL;
+  map->size = 0;
+  map->fd = -1;
+}
+
+int64_t getMapFileSize(const FileMap* map) {
+  struct stat info;
+  if (!map->data || map->fd == -1 || fstat(map->fd, &info) == -1) return -1;
+  return info.st_size;
+}
+
+bool mapZeroPage(void* addr) {
+  uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  void* start = (void*)((uintptr_t)addr & ~(page - 1));
+  return mmap(start, page, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+              -1, 0) != MAP_FAILED;
+}
+
+bool writeFileFromMap(FILE* fp, int64_t to, const FileMap* map,
+                      size_t offset, size_t len) {
+  int fd = fileno(fp);
+  loff_t src_offset = offset;
+  loff_t dst_offset = to;
+
+  // Filesystems that support it can share the blocks instead of copying
+  while (len > 0 && map->fd != -1) {
+    ssize_t copied =
+        copy_file_range(map->fd, &src_offset, fd, &dst_offset, len, 0);
+    if (copied < 0 && errno == EINTR) continue;
+    if (copied <= 0) break;
+    len -= copied;
+  }
+
+  // Not supported, fall back to writing from the mapping
+  const char* p = map->data + src_offset;
+  while (len > 0) {
+    ssize_t written = pwrite(fd, p, len, dst_offset);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += written;
+    dst_offset += written;
+    len -= written;
+  }
+  return true;
+}
+
+// Asynchronous I/O
+
+typedef enum AsyncOp {
+  ASYNC_WRITE,
+  ASYNC_READAHEAD,
+} AsyncOp;
+
+typedef struct AsyncRequest {
+  AsyncOp op;
+  int fd;
+  int64_t offset;
+  size_t len;
+  struct iovec iov[ASYNC_IOV_MAX];
+  int count;
+} AsyncRequest;
+
+// Requests go to io_uring when the kernel allows it, or to a few threads
+// that run the plain system calls otherwise. Either way up to depth requests
+// are in flight at once.
+struct AsyncIO {
+  int depth;
+  AsyncRequest* requests;
+  int* free_slots;
+  int free_count;
+  int in_flight;
+  int error;
+
+  // io_uring, ring_fd is -1 when threads are used
+  int ring_fd;
+  void* sq_ring;
+  void* cq_ring;
+  size_t sq_ring_size;
+  size_t cq_ring_size;
+  struct io_uring_sqe* sqes;
+  size_t sqes_size;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_cqe* cqes;
+
+  // Threads, guarded by mutex
+  mtx_t mutex;
+  cnd_t queued;
+  cnd_t finished;
+  int* queue;
+  int queue_head;
+  int queue_count;
+  bool stop;
+  int thread_count;
+  thrd_t threads[ASYNC_THREADS];
+};
+
+// Write everything, even if the kernel takes it in parts
+static bool pwriteAll(int fd, struct iovec* iov, int count, int64_t offset) {
+  while (count > 0) {
+    ssize_t written = pwritev(fd, iov, count, offset);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    offset += written;
+    while (count > 0 && (size_t)written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char*)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+// Called with what the system call returned, or -errno
+static void asyncComplete(AsyncIO* aio, int slot, int64_t result) {
+  AsyncRequest* request = &aio->requests[slot];
+  if (request->op == ASYNC_WRITE && !aio->error) {
+    if (result < 0) {
+      aio->error = -result;
+    } else if ((size_t)result < request->len) {
+      // Short write, finish the rest here
+      int64_t offset = request->offset + result;
+      struct iovec* iov = request->iov;
+      int count = request->count;
+      while (count > 0 && (size_t)result >= iov->iov_len) {
+        result -= iov->iov_len;
+        iov++;
+        count--;
+      }
+      iov->iov_base = (char*)iov->iov_base + result;
+      iov->iov_len -= result;
+      if (!pwriteAll(request->fd, iov, count, offset)) aio->error = errno;
+    }
+  }
+  // Readahead is only a hint, its errors don't matter
+
+  aio->free_slots[aio->free_count++] = slot;
+  aio->in_flight--;
+}
+
+static bool uringInit(AsyncIO* aio) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, aio->depth, &params);
+  if (fd < 0) return false;
+
+  aio->ring_fd = fd;
+  aio->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  aio->cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    if (aio->cq_ring_size > aio->sq_ring_size)
+      aio->sq_ring_size = aio->cq_ring_size;
+    aio->cq_ring_size = aio->sq_ring_size;
+  }
+
+  aio->sq_ring = mmap(NULL, aio->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  aio->cq_ring = single_mmap ? aio->sq_ring
+                             : mmap(NULL, aio->cq_ring_size,
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, fd,
+                                    IORING_OFF_CQ_RING);
+  aio->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  aio->sqes = mmap(NULL, aio->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (aio->sq_ring == MAP_FAILED || aio->cq_ring == MAP_FAILED ||
+      aio->sqes == MAP_FAILED) {
+    if (aio->sq_ring != MAP_FAILED) munmap(aio->sq_ring, aio->sq_ring_size);
+    if (!single_mmap && aio->cq_ring != MAP_FAILED)
+      munmap(aio->cq_ring, aio->cq_ring_size);
+    if (aio->sqes != MAP_FAILED) munmap(aio->sqes, aio->sqes_size);
+    close(fd);
+    aio->ring_fd = -1;
+    return false;
+  }
+
+  char* sq = aio->sq_ring;
+  char* cq = aio->cq_ring;
+  aio->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+  aio->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+  aio->sq_array = (unsigned*)(sq + params.sq_off.array);
+  aio->cq_head = (unsigned*)(cq + params.cq_off.head);
+  aio->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+  aio->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+  aio->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+  return true;
+}
+
+static void uringFree(AsyncIO* aio) {
+  if (aio->cq_ring != aio->sq_ring) munmap(aio->cq_ring, aio->cq_ring_size);
+  munmap(aio->sq_ring, aio->sq_ring_size);
+  munmap(aio->sqes, aio->sqes_size);
+  close(aio->ring_fd);
+}
+
+static int uringEnter(AsyncIO* aio, unsigned submit, unsigned wait) {
+  int result;
+  do {
+    result = syscall(__NR_io_uring_enter, aio->ring_fd, submit, wait,
+                     wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  } while (result < 0 && errno == EINTR);
+  return result;
+}
+
+static void uringReap(AsyncIO* aio, bool wait) {
+  if (wait) uringEnter(aio, 0, 1);
+
+  unsigned head = *aio->cq_head;
+  unsigned tail = __atomic_load_n(aio->cq_tail, __ATOMIC_ACQUIRE);
+  while (head != tail) {
+    const struct io_uring_cqe* cqe = &aio->cqes[head & *aio->cq_mask];
+    asyncComplete(aio, cqe->user_data, cqe->res);
+    head++;
+  }
+  __atomic_store_n(aio->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static bool uringSubmit(AsyncIO* aio, int slot) {
+  const AsyncRequest* request = &aio->requests[slot];
+  unsigned tail = *aio->sq_tail;
+  unsigned index = tail & *aio->sq_mask;
+  struct io_uring_sqe* sqe = &aio->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->fd = request->fd;
+  sqe->off = request->offset;
+  sqe->user_data = slot;
+  if (request->op == ASYNC_WRITE) {
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->addr = (uintptr_t)request->iov;
+    sqe->len = request->count;
+  } else {
+    sqe->opcode = IORING_OP_FADVISE;
+    sqe->len = request->len;
+    sqe->fadvise_advice = POSIX_FADV_WILLNEED;
+  }
+  aio->sq_array[index] = index;
+  __atomic_store_n(aio->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  if (uringEnter(aio, 1, 0) == 1) return true;
+
+  // The kernel didn't take it, so it can be taken back
+  __atomic_store_n(aio->sq_tail, tail, __ATOMIC_RELEASE);
+  return false;
+}
+
+static void asyncRun(AsyncRequest* request, int64_t* result) {
+  if (request->op == ASYNC_WRITE) {
+    *result = pwriteAll(request->fd, request->iov, request->count,
+                        request->offset)
+                  ? (int64_t)request->len
+                  : -errno;
+  } else {
+    *result = -posix_fadvise(request->fd, request->offset, request->len,
+                             POSIX_FADV_WILLNEED);
+  }
+}
+
+static int asyncThread(void* arg) {
+  AsyncIO* aio = arg;
+  mtx_lock(&aio->mutex);
+  while (true) {
+    while (!aio->queue_count && !aio->stop) cnd_wait(&aio->queued, &aio->mutex);
+    if (!aio->queue_count) break;
+
+    int slot = aio->queue[aio->queue_head];
+    aio->queue_head = (aio->queue_head + 1) % aio->depth;
+    aio->queue_count--;
+    mtx_unlock(&aio->mutex);
+
+    int64_t result;
+    asyncRun(&aio->requests[slot], &result);
+
+    mtx_lock(&aio->mutex);
+    asyncComplete(aio, slot, result);
+    cnd_signal(&aio->finished);
+  }
+  mtx_unlock(&aio->mutex);
+  return 0;
+}
+
+AsyncIO* asyncInit(int depth) {
+  AsyncIO* aio = calloc_s(1, sizeof(AsyncIO));
+  aio->depth = depth;
+  aio->requests = malloc_s(sizeof(AsyncRequest) * depth);
+  aio->free_slots = malloc_s(sizeof(int) * depth);
+  aio->queue = malloc_s(sizeof(int) * depth);
+  for (int i = 0; i < depth; i++) {
+    aio->free_slots[aio->free_count++] = i;
+  }
+
+  aio->ring_fd = -1;
+  if (uringInit(aio)) return aio;
+
+  // io_uring can be missing or blocked, fall back to threads
+  if (mtx_init(&aio->mutex, mtx_plain) != thrd_success) goto fail_mutex;
+  if (cnd_init(&aio->queued) != thrd_success) goto fail_queued;
+  if (cnd_init(&aio->finished) != thrd_success) goto fail_finished;
+  int thread_count = depth < ASYNC_THREADS ? depth : ASYNC_THREADS;
+  for (int i = 0; i < thread_count; i++) {
+    if (thrd_create(&aio->threads[i], asyncThread, aio) != thrd_success)
+      break;
+    aio->thread_count++;
+  }
+  // Requests still run synchronously without threads
+  return aio;
+
+fail_finished:
+  cnd_destroy(&aio->queued);
+fail_queued:
+  mtx_destroy(&aio->mutex);
+fail_mutex:
+  free(aio->requests);
+  free(aio->free_slots);
+  free(aio->queue);
+  free(aio);
+  return NULL;
+}
+
+// Get a free slot, waiting for a request to finish if there's none
+static int asyncGetSlot(AsyncIO* aio) {
+  if (aio->ring_fd != -1) {
+    while (!aio->free_count) uringReap(aio, true);
+  } else {
+    while (!aio->free_count) cnd_wait(&aio->finished, &aio->mutex);
+  }
+  aio->in_flight++;
+  return aio->free_slots[--aio->free_count];
+}
+
+static void asyncSubmit(AsyncIO* aio, int slot) {
+  if (aio->ring_fd != -1) {
+    if (!uringSubmit(aio, slot)) {
+      // Not taken by the kernel, run it here instead
+      int64_t result;
+      asyncRun(&aio->requests[slot], &result);
+      asyncComplete(aio, slot, result);
+    }
+    uringReap(aio, false);
+    return;
+  }
+
+  if (!aio->thread_count) {
+    int64_t result;
+    asyncRun(&aio->requests[slot], &result);
+    asyncComplete(aio, slot, result);
+    return;
+  }
+  int tail = (aio->queue_head + aio->queue_count) % aio->depth;
+  aio->queue[tail] = slot;
+  aio->queue_count++;
+  cnd_signal(&aio->queued);
+}
+
+bool asyncWrite(AsyncIO* aio, FILE* fp, const IOVec* vec, int count,
+                int64_t offset) {
+  if (aio->ring_fd == -1) mtx_lock(&aio->mutex);
+
+  while (count > 0) {
+    int slot = asyncGetSlot(aio);
+    AsyncRequest* request = &aio->requests[slot];
+    request->op = ASYNC_WRITE;
+    request->fd = fileno(fp);
+    request->offset = offset;
+    request->count = count < ASYNC_IOV_MAX ? count : ASYNC_IOV_MAX;
+    request->len = 0;
+    for (int i = 0; i < request->count; i++) {
+      request->iov[i].iov_base = (void*)vec[i].data;
+      request->iov[i].iov_len = vec[i].len;
+      request->len += vec[i].len;
+    }
+    offset += request->len;
+    vec += request->count;
+    count -= request->count;
+    asyncSubmit(aio, slot);
+  }
+
+  bool success = !aio->error;
+  if (aio->ring_fd == -1) mtx_unlock(&aio->mutex);
+  return success;
+}
+
+void asyncReadahead(AsyncIO* aio, const FileMap* map, size_t offset,
+                    size_t len) {
+  if (map->fd == -1) return;
+  if (aio->ring_fd == -1) mtx_lock(&aio->mutex);
+
+  while (len > 0) {
+    int slot = asyncGetSlot(aio);
+    AsyncRequest* request = &aio->requests[slot];
+    request->op = ASYNC_READAHEAD;
+    request->fd = map->fd;
+    request->offset = offset;
+    request->len = len < ASYNC_READAHEAD_MAX ? len : ASYNC_READAHEAD_MAX;
+    offset += request->len;
+    len -= request->len;
+    asyncSubmit(aio, slot);
+  }
+
+  if (aio->ring_fd == -1) mtx_unlock(&aio->mutex);
+}
+
+bool asyncWait(AsyncIO* aio) {
+  if (aio->ring_fd != -1) {
+    while (aio->in_flight) uringReap(aio, true);
+  } else {
+    mtx_lock(&aio->mutex);
+    while (aio->in_flight) cnd_wait(&aio->finished, &aio->mutex);
+    mtx_unlock(&aio->mutex);
+  }
+
+  if (aio->error) {
+    errno = aio->error;
+    return false;
+  }
+  return true;
+}
+
+void asyncFree(AsyncIO* aio) {
+  if (!aio) return;
+  asyncWait(aio);
+
+  if (aio->ring_fd != -1) {
+    uringFree(aio);
+  } else {
+    mtx_lock(&aio->mutex);
+    aio->stop = true;
+    cnd_broadcast(&aio->queued);
+    mtx_unlock(&aio->mutex);
+    for (int i = 0; i < aio->thread_count; i++) {
+      thrd_join(aio->threads[i], NULL);
+    }
+    cnd_destroy(&aio->finished);
+    cnd_destroy(&aio->queued);
+    mtx_destroy(&aio->mutex);
+  }
+  free(aio->requests);
+  free(aio->free_slots);
+  free(aio->queue);
+  free(aio);
+}
+
+// Main loop wake up
+
+static int wake_pipe[2] = {-1, -1};
+static once_flag wake_once = ONCE_FLAG_INIT;
+
+static void initWakePipe(void) {
+  if (pipe2(wake_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+    wake_pipe[0] = wake_pipe[1] = -1;
+  }
+}
+
+void wakeMainLoop(void) {
+  call_once(&wake_once, initWakePipe);
+  if (wake_pipe[1] != -1) UNUSED(write(wake_pipe[1], "", 1));
+}
+
+static int input_stream = -1;
+
+bool waitForInput(int timeout) {
+  call_once(&wake_once, initWakePipe);
+
+  // poll skips the ones that are -1
+  struct pollfd fds[3] = {
+      {.fd = STDIN_FILENO, .events = POLLIN},
+      {.fd = wake_pipe[0], .events = POLLIN},
+      {.fd = input_stream, .events = POLLIN},
+  };
+  int result = poll(fds, 3, timeout);
+  if (result <= 0) return false;
+
+  if (wake_pipe[0] != -1 && (fds[1].revents & POLLIN)) {
+    char buf[64];
+    while (read(wake_pipe[0], buf, sizeof(buf)) > 0) {
+    }
+  }
+  return fds[0].revents & POLLIN;
+}
+
+bool openInputStream(void) {
+  if (input_stream != -1 || isatty(STDIN_FILENO)) return false;
+
+  int tty = open("/dev/tty", O_RDWR | O_CLOEXEC);
+  if (tty == -1) return false;
+
+  int fd = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0);
+  if (fd == -1 || dup2(tty, STDIN_FILENO) == -1) {
+    if (fd != -1) close(fd);
+    close(tty);
+    return false;
+  }
+  close(tty);
+
+  int flags = fcntl(fd, F_GETFL);
+  if (flags != -1) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+  input_stream = fd;
+  return true;
+}
+
+int64_t readInputStream(char* buf, size_t len) {
+  if (input_stream == -1) return -1;
+
+  ssize_t n = read(input_stream, buf, len);
+  if (n >= 0) return n ? n : -1;
+  return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+}
+
+void closeInputStream(void) {
+  if (input_stream == -1) return;
+  close(input_stream);
+  input_stream = -1;
+}
+
+FILE* openTempFile(const char* path, char* temp_path) {
+  char parent_dir[EDITOR_PATH_MAX];
+  char base_name[EDITOR_PATH_MAX];
+
+  snprintf(parent_dir, sizeof(parent_dir), "%s", path);
+  snprintf(base_name, sizeof(base_name), "%s", getBaseName(parent_dir));
+  getDirName(parent_dir);
+
+  int len = snprintf(temp_path, EDITOR_PATH_MAX, "%s/.%s.XXXXXX", parent_dir,
+                     base_name);
+  if (len < 0 || len >= EDITOR_PATH_MAX) {
+    errno = ENAMETOOLONG;
+    return NULL;
+  }
+
+  // Renaming over a link would replace the link itself, or leave the other
+  // names of the file with the old text
+  struct stat info;
+  bool exists = lstat(path, &info) == 0;
+  if (exists && (S_ISLNK(info.st_mode) || info.st_nlink > 1)) {
+    errno = EMLINK;
+    return NULL;
+  }
+
+  int fd = mkstemp(temp_path);
+  if (fd == -1) return NULL;
+
+  if (exists) {
+    UNUSED(fchmod(fd, info.st_mode & 07777));
+    // Someone else's file would become ours
+    if (fchown(fd, info.st_uid, info.st_gid) != 0) {
+      close(fd);
+      unlink(temp_path);
+      errno = EPERM;
+      return NULL;
+    }
+  } else {
+    mode_t mask = umask(0);
+    umask(mask);
+    UNUSED(fchmod(fd, 0666 & ~mask));
+  }
+
+  FILE* fp = fdopen(fd, "wb");
+  if (!fp) {
+    close(fd);
+    unlink(temp_path);
+  }
+  return fp;
+}
+
+bool replaceFile(const char* from, const char* to) {
+  return rename(from, to) == 0;
+}
+
 bool changeDir(const char* path) { return chdir(path) == 0; }
 
+bool getConfigPath(char* path, const char* dir, const char* name) {
+  const char* home = getenv(ENV_HOME);
+  if (!home) return false;
+
+  int len = snprintf(path, EDITOR_PATH_MAX, "%s/" CONF_DIR "/%s/%s", home, dir,
+                     name);
+  if (len < 0 || len >= EDITOR_PATH_MAX) return false;
+
+  // mkdir -p everything before the name
+  char* name_start = path + len - strlen(name);
+  for (char* p = path + strlen(home) + 1; p < name_start; p++) {
+    if (*p != '/') continue;
+    *p = '\0';
+    bool success = (mkdir(path, 0700) == 0 || errno == EEXIST);
+    *p = '/';
+    if (!success) return false;
+  }
+  return true;
+}
+
 char* getFullPath(const char* path) {
   static char resolved_path[EDITOR_PATH_MAX];
   if (realpath(path, resolved_path) == NULL) {
@@ -90,6 +738,18 @@ int64_t getTime(void) {
   return time_val.tv_sec * 1000000 + time_val.tv_usec;
 }
 
+int getCpuCount(void) {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return (count < 1) ? 1 : (int)count;
+}
+
+uint64_t getMemorySize(void) {
+  long pages = sysconf(_SC_PHYS_PAGES);
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (pages < 1 || page_size < 1) return UINT64_MAX;
+  return (uint64_t)pages * page_size;
+}
+
 Args argsGet(int num_args, char** args) {
   return (Args){.count = num_args, .args = args};
 }
@@ -13,12 +13,25 @@
 #include <linux/limits.h>
 #define EDITOR_PATH_MAX PATH_MAX
 
+// Buffers in one asynchronous write
+#define ASYNC_IOV_MAX 64
+// Largest range a readahead request asks for
+#define ASYNC_READAHEAD_MAX (64 << 20)
+// Threads used when io_uring isn't available
+#define ASYNC_THREADS 4
+
 struct FileInfo {
   struct stat info;
 
   bool error;
 };
 
+struct FileMap {
+  char* data;
+  size_t size;
+  int fd;
+};
+
 struct DirIter {
   DIR* dp;
   struct dirent* entry;
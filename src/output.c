@@ -9,6 +9,7 @@
 #include "config.h"
 #include "defines.h"
 #include "editor.h"
+#include "encoding.h"
 #include "os.h"
 #include "prompt.h"
 #include "select.h"
@@ -54,8 +55,9 @@ static void editorDrawTopStatusBar(abuf* ab) {
       char buf[EDITOR_PATH_MAX] = {0};
       const char* filename =
           file->filename ? getBaseName(file->filename) : "Untitled";
-      int buf_len = snprintf(buf, sizeof(buf), " %s%s ", file->dirty ? "*" : "",
-                             filename);
+      int buf_len =
+          snprintf(buf, sizeof(buf), " %s%s%s ", file->dirty ? "*" : "",
+                   filename, file->saver ? EDITOR_SAVING_LABEL : "");
       int tab_width = strUTF8Width(buf);
 
       if (editor.screen_cols - len < tab_width ||
@@ -192,7 +194,7 @@ static void editorDrawStatusBar(abuf* ab) {
   };
   help_str = help_info[editor.state];
 
-  char lang[16];
+  char lang[32];
   char pos[64];
   int len = strlen(help_str);
   int lang_len, pos_len;
@@ -203,19 +205,66 @@ static void editorDrawStatusBar(abuf* ab) {
   } else {
     const char* file_type = "Plain Text";
     int row = current_file->cursor.y + 1;
-    int col = editorRowCxToRx(&current_file->row[current_file->cursor.y],
-                              current_file->cursor.x) +
+    int col = editorRowCxToRx(
+                  editorPeekRow(current_file, current_file->cursor.y),
+                  current_file->cursor.x) +
               1;
     float line_percent = 0.0f;
-    const char* nl_type = (current_file->newline == NL_UNIX) ? "LF" : "CRLF";
+    char nl_type[32];
+    const char* newline = (current_file->newline == NL_UNIX) ? "LF" : "CRLF";
+    if (current_file->encoding == ENC_UTF8) {
+      snprintf(nl_type, sizeof(nl_type), "%s", newline);
+    } else {
+      snprintf(nl_type, sizeof(nl_type), "%s %s",
+               getEncodingName(current_file->encoding), newline);
+    }
     if (current_file->num_rows - 1 > 0) {
       line_percent = (float)current_file->row_offset /
                      (current_file->num_rows - 1) * 100.0f;
     }
 
-    lang_len = snprintf(lang, sizeof(lang), "  %s  ", file_type);
-    pos_len = snprintf(pos, sizeof(pos), " %d:%d [%.f%%] <%s> ", row, col,
-                       line_percent, nl_type);
+    if (current_file->hex) {
+      const EditorHexView* hex = current_file->hex;
+      int percent = (int)(hex->cursor * 100 / current_file->map.size);
+      lang_len = snprintf(lang, sizeof(lang), "  Hex  ");
+      pos_len = snprintf(pos, sizeof(pos), " 0x%0*llx [%d%%] ",
+                         editorHexOffsetWidth(current_file),
+                         (unsigned long long)hex->cursor, percent);
+    } else if (current_file->pager) {
+      // Lines aren't all loaded, show where the screen is in the file
+      int64_t lineno = editorGetLineNumber(current_file, row - 1);
+      const EditorRow* top =
+          editorGetRow(current_file, current_file->row_offset);
+      // The window can be empty while it slides to another part of the file
+      int percent = top ? (int)((top->data - current_file->map.data) * 100 /
+                                current_file->map.size)
+                        : 0;
+      if (editorPagerLineCount(current_file) < 0) {
+        lang_len = snprintf(lang, sizeof(lang), "  View, indexing %d%%  ",
+                            editorPagerProgress(current_file));
+      } else {
+        lang_len = snprintf(lang, sizeof(lang), "  View  ");
+      }
+      if (lineno > 0) {
+        pos_len = snprintf(pos, sizeof(pos), " %lld:%d [%d%%] <%s> ",
+                           (long long)lineno, col, percent, nl_type);
+      } else {
+        pos_len = snprintf(pos, sizeof(pos), " ?:%d [%d%%] <%s> ", col,
+                           percent, nl_type);
+      }
+    } else if (current_file->loader) {
+      lang_len = snprintf(lang, sizeof(lang), "  Loading %d%%  ",
+                          editorLoadProgress(current_file));
+      pos_len = snprintf(pos, sizeof(pos), " %d:%d [%d lines] <%s> ", row,
+                         col, current_file->num_rows, nl_type);
+    } else {
+      if (current_file->follow) {
+        file_type = current_file->stream ? "Reading" : "Following";
+      }
+      lang_len = snprintf(lang, sizeof(lang), "  %s  ", file_type);
+      pos_len = snprintf(pos, sizeof(pos), " %d:%d [%.f%%] <%s> ", row, col,
+                         line_percent, nl_type);
+    }
   }
 
   rlen = lang_len + pos_len;
@@ -241,11 +290,86 @@ static void editorDrawStatusBar(abuf* ab) {
   }
 }
 
+// Only the bytes on screen are read from the mapping
+static void editorDrawHexRows(abuf* ab) {
+  const EditorHexView* hex = current_file->hex;
+  const uint8_t* data = (const uint8_t*)current_file->map.data;
+  size_t size = current_file->map.size;
+  int bytes_per_row = editorHexBytesPerRow(current_file);
+  int offset_width = editorHexOffsetWidth(current_file);
+  size_t offset = hex->top - hex->top % bytes_per_row;
+  static const char digits[] = "0123456789abcdef";
+
+  for (int s_row = 2; s_row < editor.display_rows + 2; s_row++) {
+    gotoXY(ab, s_row, 1);
+    if (offset >= size) {
+      setColor(ab, editor.color_cfg.bg, 1);
+      abufAppend(ab, "\x1b[K");
+      continue;
+    }
+
+    size_t row_end = offset + bytes_per_row;
+    bool is_cursor_row = hex->cursor >= offset && hex->cursor < row_end;
+    if (is_cursor_row) {
+      setColor(ab, editor.color_cfg.line_number[1], 0);
+      setColor(ab, editor.color_cfg.line_number[0], 1);
+    } else {
+      setColor(ab, editor.color_cfg.line_number[0], 0);
+      setColor(ab, editor.color_cfg.line_number[1], 1);
+    }
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), " %0*llx ", offset_width,
+                       (unsigned long long)offset);
+    abufAppendN(ab, buf, len);
+
+    abufAppend(ab, ANSI_CLEAR);
+    Color bg = is_cursor_row ? editor.color_cfg.cursor_line
+                             : editor.color_cfg.bg;
+    setColor(ab, editor.color_cfg.highlightFg[HL_NORMAL], 0);
+    setColor(ab, bg, 1);
+
+    // The hex part is built in one buffer, from after the offset to the
+    // ASCII part
+    char line[128];
+    int line_len = editorHexColumn(current_file, bytes_per_row, 0, true) - len;
+    memset(line, ' ', line_len);
+    for (int i = 0; i < bytes_per_row && offset + i < size; i++) {
+      uint8_t c = data[offset + i];
+      char* p =
+          &line[editorHexColumn(current_file, bytes_per_row, i, false) - len];
+      p[0] = digits[c >> 4];
+      p[1] = digits[c & 0x0F];
+    }
+    abufAppendN(ab, line, line_len);
+
+    for (int i = 0; i < bytes_per_row && offset + i < size; i++) {
+      uint8_t c = data[offset + i];
+      char sym = (c >= 0x20 && c < 0x7F) ? (char)c : '.';
+      if (offset + i == hex->cursor) {
+        setColor(ab, editor.color_cfg.highlightBg[HL_BG_SELECT], 1);
+        abufAppendN(ab, &sym, 1);
+        setColor(ab, bg, 1);
+      } else {
+        abufAppendN(ab, &sym, 1);
+      }
+    }
+    abufAppend(ab, "\x1b[K");
+    setColor(ab, editor.color_cfg.bg, 1);
+    offset = row_end;
+  }
+}
+
 static void editorDrawRows(abuf* ab) {
+  if (current_file->hex) {
+    editorDrawHexRows(ab);
+    return;
+  }
+
   setColor(ab, editor.color_cfg.bg, 1);
 
   EditorSelectRange range = {0};
   if (current_file->cursor.is_selected) getSelectStartEnd(&range);
+  char* text = malloc_s(editor.screen_cols + 1);
 
   for (int i = current_file->row_offset, s_row = 2;
        i < current_file->row_offset + editor.display_rows; i++, s_row++) {
@@ -268,25 +392,39 @@ static void editorDrawRows(abuf* ab) {
         setColor(ab, editor.color_cfg.line_number[1], 1);
       }
 
-      snprintf(line_number, sizeof(line_number), " %*d ",
-               current_file->lineno_width - 2, i + 1);
+      int64_t lineno = editorGetLineNumber(current_file, i);
+      if (lineno > 0) {
+        snprintf(line_number, sizeof(line_number), " %*lld ",
+                 current_file->lineno_width - 2, (long long)lineno);
+      } else {
+        snprintf(line_number, sizeof(line_number), " %*s ",
+                 current_file->lineno_width - 2, "?");
+      }
       abufAppend(ab, line_number);
 
       abufAppend(ab, ANSI_CLEAR);
       setColor(ab, editor.color_cfg.bg, 1);
 
+      const EditorRow* row = editorPeekRow(current_file, i);
       int cols = editor.screen_cols - current_file->lineno_width;
-      int col_offset =
-          editorRowRxToCx(&current_file->row[i], current_file->col_offset);
-      int len = current_file->row[i].size - col_offset;
+      int col_offset = editorRowRxToCx(row, current_file->col_offset);
+      int len = row->size - col_offset;
       len = (len < 0) ? 0 : len;
 
-      int rlen = current_file->row[i].rsize - current_file->col_offset;
-      is_row_full = (rlen > cols);
-      rlen = is_row_full ? cols : rlen;
-      rlen += current_file->col_offset;
+      // Drawn up to the end of the row or the edge of the screen, whichever
+      // comes first
+      int rlen = current_file->col_offset + cols;
 
-      char* c = &current_file->row[i].data[col_offset];
+      const char* c = &row->data[col_offset];
+      if (row->plain) {
+        // Typing can leave a gap in these, the part on screen is copied out
+        if (len > cols) {
+          len = (cols > 0) ? cols : 0;
+          is_row_full = true;
+        }
+        editorCopyRowText(current_file, i, col_offset, len, text);
+        c = text;
+      }
 
       uint8_t curr_fg = HL_BG_NORMAL;
       uint8_t curr_bg = HL_NORMAL;
@@ -296,7 +434,7 @@ static void editorDrawRows(abuf* ab) {
 
       int j = 0;
       int rx = current_file->col_offset;
-      while (rx < rlen) {
+      while (j < len && rx < rlen) {
         if (iscntrl(c[j]) && c[j] != '\t') {
           char sym = (c[j] <= 26) ? '@' + c[j] : '?';
           abufAppend(ab, ANSI_INVERT);
@@ -352,10 +490,11 @@ static void editorDrawRows(abuf* ab) {
         }
       }
 
+      if (j < len) is_row_full = true;
+
       // Add newline character when selected
       if (current_file->cursor.is_selected && range.end_y > i &&
-          i >= range.start_y &&
-          current_file->row[i].rsize - current_file->col_offset < cols) {
+          i >= range.start_y && rx - current_file->col_offset < cols) {
         setColor(ab, editor.color_cfg.highlightBg[HL_BG_SELECT], 1);
         abufAppend(ab, " ");
       }
@@ -364,6 +503,7 @@ static void editorDrawRows(abuf* ab) {
     if (!is_row_full) abufAppend(ab, "\x1b[K");
     setColor(ab, editor.color_cfg.bg, 1);
   }
+  free(text);
 }
 
 void editorRefreshScreen(void) {
@@ -383,10 +523,23 @@ void editorRefreshScreen(void) {
   bool should_show_cursor = true;
   if (editor.state == EDIT_MODE) {
     int row = (current_file->cursor.y - current_file->row_offset) + 2;
-    int col = (editorRowCxToRx(&current_file->row[current_file->cursor.y],
-                               current_file->cursor.x) -
+    int col = (editorRowCxToRx(
+                   editorPeekRow(current_file, current_file->cursor.y),
+                   current_file->cursor.x) -
                current_file->col_offset) +
               1 + current_file->lineno_width;
+    if (current_file->hex) {
+      const EditorHexView* hex = current_file->hex;
+      int bytes_per_row = editorHexBytesPerRow(current_file);
+      size_t top = hex->top - hex->top % bytes_per_row;
+      int64_t y = (hex->cursor >= top)
+                      ? (int64_t)((hex->cursor - top) / bytes_per_row)
+                      : -1;
+      row = (y < editor.display_rows) ? (int)y + 2 : 0;
+      col = editorHexColumn(current_file, bytes_per_row,
+                            hex->cursor % bytes_per_row, false) +
+            1;
+    }
     if (row <= 1 || row > editor.screen_rows - 1 || col <= 1 ||
         col > editor.screen_cols ||
         row >= editor.screen_rows - editor.con_size) {
@@ -0,0 +1,522 @@
+#include "pager.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "editor.h"
+#include "scan.h"
+#include "utils.h"
+
+// Rows kept around the screen
+#define PAGER_WINDOW_ROWS 4096
+// The window moves when the screen gets this close to its edges
+#define PAGER_WINDOW_MARGIN 1024
+// Every n-th line start is remembered for seeking
+#define PAGER_CHECKPOINT_LINES 4096
+
+// The index cache is a header of PagerIndexHeader followed by the
+// checkpoints, all in native byte order so it can be used where it's mapped
+#define PAGER_INDEX_MAGIC "NINOIDX\x01"
+
+typedef struct PagerIndexHeader {
+  char magic[8];
+  uint64_t id;
+  uint64_t size;
+  uint64_t mtime;
+  uint64_t interval;
+  uint64_t newlines;
+  uint64_t count;
+} PagerIndexHeader;
+
+// Newlines are counted on a separate thread, which gives line numbers to
+// the window and lets goto seek to a checkpoint instead of the file start.
+struct EditorPager {
+  thrd_t thread;
+  mtx_t mutex;
+  bool indexing;
+
+  // Only touched by the worker
+  const char* data;
+  size_t size;
+  // Where the index is cached, empty if it isn't
+  char index_path[EDITOR_PATH_MAX];
+  FileStamp stamp;
+
+  // Checkpoints read from the cache point into this
+  FileMap index_map;
+
+  // Guarded by mutex
+  size_t* checkpoints;
+  int64_t checkpoint_count;
+  size_t checkpoint_cap;
+  int64_t newlines;
+  size_t indexed_size;
+  bool done;
+  bool cancel;
+
+  // Rows of the window are scanned into this before they replace the old
+  // ones
+  EditorRow* window;
+  // Line number of the first row starting from 0, -1 if not known yet
+  int64_t line_base;
+  // Offset after the last row in the window
+  size_t window_end;
+};
+
+static bool indexPath(const char* filename, char* path) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.idx",
+           (unsigned long long)hashString(filename));
+  return getConfigPath(path, "index", name);
+}
+
+// Written once the whole file is indexed, so the next open can skip it
+static void pagerSaveIndex(EditorPager* pager) {
+  char temp_path[EDITOR_PATH_MAX];
+  FILE* fp = openTempFile(pager->index_path, temp_path);
+  if (!fp) return;
+
+  PagerIndexHeader header = {
+      .id = pager->stamp.id,
+      .size = pager->stamp.size,
+      .mtime = pager->stamp.mtime,
+      .interval = PAGER_CHECKPOINT_LINES,
+      .newlines = pager->newlines,
+      .count = pager->checkpoint_count,
+  };
+  memcpy(header.magic, PAGER_INDEX_MAGIC, sizeof(header.magic));
+
+  size_t count = pager->checkpoint_count;
+  bool success = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                 fwrite(pager->checkpoints, sizeof(size_t), count, fp) == count;
+  success = (fclose(fp) == 0) && success;
+  if (success) success = replaceFile(temp_path, pager->index_path);
+  if (!success) remove(temp_path);
+}
+
+// Use the cached index if it was made for this version of the file
+static bool pagerLoadIndex(EditorPager* pager) {
+  if (sizeof(size_t) != sizeof(uint64_t)) return false;
+
+  FILE* fp = openFile(pager->index_path, "rb");
+  if (!fp) return false;
+  FileMap map;
+  bool mapped = mapFile(&map, fp);
+  fclose(fp);
+  if (!mapped) return false;
+
+  const PagerIndexHeader* header = (const PagerIndexHeader*)map.data;
+  const size_t* checkpoints = (const size_t*)(map.data + sizeof(*header));
+  bool valid =
+      map.size >= sizeof(*header) &&
+      memcmp(header->magic, PAGER_INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+      header->id == pager->stamp.id &&
+      header->size == (uint64_t)pager->stamp.size &&
+      header->mtime == (uint64_t)pager->stamp.mtime &&
+      header->interval == PAGER_CHECKPOINT_LINES && header->count > 0 &&
+      header->count == (map.size - sizeof(*header)) / sizeof(size_t) &&
+      map.size == sizeof(*header) + header->count * sizeof(size_t) &&
+      checkpoints[0] == 0;
+  for (uint64_t i = 1; valid && i < header->count; i++) {
+    valid = checkpoints[i] > checkpoints[i - 1] &&
+            checkpoints[i] <= pager->size;
+  }
+
+  // A stale index is made again by the indexer
+  if (!valid) {
+    unmapFile(&map);
+    return false;
+  }
+
+  free(pager->checkpoints);
+  pager->checkpoints = (size_t*)checkpoints;
+  pager->checkpoint_count = header->count;
+  pager->checkpoint_cap = header->count;
+  pager->newlines = header->newlines;
+  pager->indexed_size = pager->size;
+  pager->done = true;
+  pager->index_map = map;
+  return true;
+}
+
+static int indexerThread(void* arg) {
+  EditorPager* pager = arg;
+  const char* p = pager->data;
+  const char* end = p + pager->size;
+  int64_t newlines = 0;
+
+  while (p < end) {
+    const char* nl = memchr(p, '\n', end - p);
+    if (!nl) break;
+    p = nl + 1;
+    newlines++;
+
+    if (newlines % PAGER_CHECKPOINT_LINES == 0) {
+      mtx_lock(&pager->mutex);
+      if ((size_t)pager->checkpoint_count == pager->checkpoint_cap) {
+        pager->checkpoint_cap *= 2;
+        pager->checkpoints = realloc_s(
+            pager->checkpoints, sizeof(size_t) * pager->checkpoint_cap);
+      }
+      pager->checkpoints[pager->checkpoint_count++] = p - pager->data;
+      pager->newlines = newlines;
+      pager->indexed_size = p - pager->data;
+      bool cancel = pager->cancel;
+      mtx_unlock(&pager->mutex);
+
+      if (cancel) return 0;
+    }
+  }
+
+  mtx_lock(&pager->mutex);
+  pager->newlines = newlines;
+  pager->indexed_size = pager->size;
+  pager->done = true;
+  mtx_unlock(&pager->mutex);
+
+  // The main thread doesn't change the index once it's done
+  if (pager->index_path[0]) pagerSaveIndex(pager);
+  wakeMainLoop();
+  return 0;
+}
+
+static int countDigits(int64_t n) {
+  int digits = 1;
+  while (n >= 10) {
+    n /= 10;
+    digits++;
+  }
+  return digits;
+}
+
+static int64_t countNewlines(const char* p, const char* end) {
+  int64_t count = 0;
+  while ((p = memchr(p, '\n', end - p)) != NULL) {
+    p++;
+    count++;
+  }
+  return count;
+}
+
+static const char* prevLineStart(const char* start, const char* p) {
+  p--;
+  while (p > start && p[-1] != '\n') p--;
+  return p;
+}
+
+static char* pagerScanRow(char* p, char* end, EditorRow* row) {
+  int flags;
+  char* nl = (char*)scanLine(p, end, &flags);
+  int64_t size = nl - p;
+  while (size > 0 && p[size - 1] == '\r') size--;
+  // Rows hold an int, a longer line is cut off in view mode
+  if (size > INT_MAX) size = INT_MAX;
+
+  row->data = p;
+  row->size = size;
+  row->mapped = true;
+  row->ascii = !(flags & LINE_NON_ASCII);
+  row->plain = !flags;
+  return (nl < end) ? nl + 1 : end;
+}
+
+static void pagerUpdateLinenoWidth(EditorFile* file) {
+  EditorPager* pager = file->pager;
+
+  mtx_lock(&pager->mutex);
+  int64_t max_line = pager->newlines + 1;
+  mtx_unlock(&pager->mutex);
+
+  if (pager->line_base + file->num_rows > max_line)
+    max_line = pager->line_base + file->num_rows;
+  file->lineno_width = countDigits(max_line) + 2;
+}
+
+// Fill the window with the lines around the one starting at offset and
+// return its index in the window
+static int pagerLoadAround(EditorFile* file, size_t offset, int64_t line) {
+  EditorPager* pager = file->pager;
+  char* map = file->map.data;
+  char* end = map + file->map.size;
+
+  char* p = map + offset;
+  int index = 0;
+  while (index < PAGER_WINDOW_ROWS / 2 && p > map) {
+    p = (char*)prevLineStart(map, p);
+    index++;
+  }
+
+  EditorRow* window = pager->window;
+  int count = 0;
+  while (p < end && count < PAGER_WINDOW_ROWS) {
+    p = pagerScanRow(p, end, &window[count++]);
+  }
+  // Newline at the end of the file starts one more line
+  if (p == end && (count == 0 || end[-1] == '\n')) {
+    EditorRow* row = &window[count++];
+    row->data = end;
+    row->size = 0;
+    row->mapped = true;
+    row->ascii = true;
+    row->plain = true;
+  }
+  // The rows are all mapped, there's nothing to free
+  editorSpliceRows(file, 0, file->num_rows, window, count);
+
+  pager->window_end = p - map;
+  pager->line_base = (line < 0) ? -1 : line - index;
+  if (index >= file->num_rows) index = file->num_rows - 1;
+
+  file->cursor.is_selected = false;
+  pagerUpdateLinenoWidth(file);
+  return index;
+}
+
+static void pagerMoveCursor(EditorFile* file, int y, int x) {
+  file->cursor.y = y;
+  file->cursor.x = x;
+  file->sx = editorRowCxToRx(editorGetRow(file, y), x);
+  file->cursor.select_x = file->cursor.x;
+  file->cursor.select_y = file->cursor.y;
+}
+
+bool editorStartPager(EditorFile* file) {
+  EditorPager* pager = calloc_s(1, sizeof(EditorPager));
+  pager->data = file->map.data;
+  pager->size = file->map.size;
+  pager->checkpoint_cap = 64;
+  pager->checkpoints = malloc_s(sizeof(size_t) * pager->checkpoint_cap);
+  pager->checkpoints[0] = 0;
+  pager->checkpoint_count = 1;
+
+  if (mtx_init(&pager->mutex, mtx_plain) != thrd_success) {
+    free(pager->checkpoints);
+    free(pager);
+    return false;
+  }
+
+  editorFreeRows(file);
+  pager->window = malloc_s(sizeof(EditorRow) * (PAGER_WINDOW_ROWS + 1));
+  file->pager = pager;
+  pagerLoadAround(file, 0, 0);
+  pagerMoveCursor(file, 0, 0);
+
+  const EditorRow* row = editorGetRow(file, 0);
+  if (row->data + row->size < file->map.data + file->map.size &&
+      row->data[row->size] == '\r') {
+    file->newline = NL_DOS;
+  }
+
+  if (file->map.size >= EDITOR_INDEX_CACHE_SIZE &&
+      indexPath(file->filename, pager->index_path)) {
+    pager->stamp = getFileStamp(file->file_info);
+    if (pagerLoadIndex(pager)) {
+      pagerUpdateLinenoWidth(file);
+      return true;
+    }
+  }
+
+  // Without the index lines can still be found by scanning
+  pager->indexing =
+      (thrd_create(&pager->thread, indexerThread, pager) == thrd_success);
+  return true;
+}
+
+void editorFreePager(EditorFile* file) {
+  EditorPager* pager = file->pager;
+  if (!pager) return;
+
+  if (pager->indexing) {
+    mtx_lock(&pager->mutex);
+    pager->cancel = true;
+    mtx_unlock(&pager->mutex);
+    thrd_join(pager->thread, NULL);
+  }
+
+  mtx_destroy(&pager->mutex);
+  if (pager->index_map.data) {
+    unmapFile(&pager->index_map);
+  } else {
+    free(pager->checkpoints);
+  }
+  free(pager->window);
+  free(pager);
+  file->pager = NULL;
+}
+
+// Find the offset of a line, starting from the closest known line before it
+static bool pagerFindLine(EditorFile* file, int64_t line, size_t* offset) {
+  EditorPager* pager = file->pager;
+  const char* map = file->map.data;
+  const char* end = map + file->map.size;
+
+  mtx_lock(&pager->mutex);
+  int64_t index = line / PAGER_CHECKPOINT_LINES;
+  if (index >= pager->checkpoint_count) index = pager->checkpoint_count - 1;
+  const char* p = map + pager->checkpoints[index];
+  int64_t p_line = index * PAGER_CHECKPOINT_LINES;
+  mtx_unlock(&pager->mutex);
+
+  if (pager->line_base > p_line && pager->line_base <= line) {
+    p = editorGetRow(file, 0)->data;
+    p_line = pager->line_base;
+  }
+
+  while (p_line < line) {
+    const char* nl = memchr(p, '\n', end - p);
+    if (!nl) return false;
+    p = nl + 1;
+    p_line++;
+  }
+
+  *offset = p - map;
+  return true;
+}
+
+// Line number of a line start, when the window has one
+static int64_t pagerLineAt(EditorFile* file, const char* p) {
+  EditorPager* pager = file->pager;
+  if (pager->line_base < 0) return -1;
+
+  const char* base = editorGetRow(file, 0)->data;
+  if (p >= base) return pager->line_base + countNewlines(base, p);
+  return pager->line_base - countNewlines(p, base);
+}
+
+bool editorPollPager(EditorFile* file) {
+  EditorPager* pager = file->pager;
+  if (!pager || !pager->indexing) return false;
+
+  mtx_lock(&pager->mutex);
+  bool done = pager->done;
+  mtx_unlock(&pager->mutex);
+
+  if (done) {
+    thrd_join(pager->thread, NULL);
+    pager->indexing = false;
+
+    // Jumped to the end before the lines were counted
+    if (pager->line_base < 0) {
+      const char* map = file->map.data;
+      size_t offset = editorGetRow(file, 0)->data - map;
+
+      int64_t index = pager->checkpoint_count - 1;
+      while (index > 0 && pager->checkpoints[index] > offset) index--;
+      pager->line_base = index * PAGER_CHECKPOINT_LINES +
+                         countNewlines(map + pager->checkpoints[index],
+                                       map + offset);
+    }
+  }
+
+  pagerUpdateLinenoWidth(file);
+  return true;
+}
+
+int editorPagerProgress(EditorFile* file) {
+  EditorPager* pager = file->pager;
+
+  mtx_lock(&pager->mutex);
+  size_t indexed_size = pager->indexed_size;
+  mtx_unlock(&pager->mutex);
+
+  return (int)(indexed_size * 100 / file->map.size);
+}
+
+int64_t editorGetLineNumber(const EditorFile* file, int y) {
+  if (!file->pager) return y + 1;
+  if (file->pager->line_base < 0) return 0;
+  return file->pager->line_base + y + 1;
+}
+
+int64_t editorPagerLineCount(EditorFile* file) {
+  EditorPager* pager = file->pager;
+
+  mtx_lock(&pager->mutex);
+  int64_t count = pager->done ? pager->newlines + 1 : -1;
+  mtx_unlock(&pager->mutex);
+
+  return count;
+}
+
+void editorPagerSlide(EditorFile* file) {
+  EditorPager* pager = file->pager;
+  if (!pager) return;
+
+  bool near_start = file->row_offset < PAGER_WINDOW_MARGIN &&
+                    editorGetRow(file, 0)->data > file->map.data;
+  bool near_end =
+      file->row_offset + editor.display_rows >
+          file->num_rows - PAGER_WINDOW_MARGIN &&
+      pager->window_end < file->map.size;
+  if (!near_start && !near_end) return;
+
+  int anchor = file->row_offset;
+  if (anchor >= file->num_rows) anchor = file->num_rows - 1;
+  const char* p = editorGetRow(file, anchor)->data;
+  int64_t line = (pager->line_base < 0) ? -1 : pager->line_base + anchor;
+
+  int cursor_y = file->cursor.y;
+  int cursor_x = file->cursor.x;
+  int index = pagerLoadAround(file, p - file->map.data, line);
+
+  // Keep the screen and the cursor where they were
+  int delta = anchor - index;
+  file->row_offset = index;
+  cursor_y -= delta;
+  if (cursor_y < 0 || cursor_y >= file->num_rows) {
+    cursor_y = index;
+    cursor_x = 0;
+  }
+  pagerMoveCursor(file, cursor_y, cursor_x);
+}
+
+void editorPagerSeekStart(EditorFile* file) {
+  int index = pagerLoadAround(file, 0, 0);
+  pagerMoveCursor(file, index, 0);
+}
+
+void editorPagerSeekEnd(EditorFile* file) {
+  const char* map = file->map.data;
+  const char* end = map + file->map.size;
+  const char* p = (end[-1] == '\n') ? end : prevLineStart(map, end);
+
+  int64_t count = editorPagerLineCount(file);
+  int index = pagerLoadAround(file, p - map, count - 1);
+  pagerMoveCursor(file, index, editorGetRow(file, index)->size);
+}
+
+bool editorPagerGoto(EditorFile* file, int64_t line) {
+  size_t offset;
+  if (!pagerFindLine(file, line, &offset)) return false;
+
+  int index = pagerLoadAround(file, offset, line);
+  pagerMoveCursor(file, index, 0);
+  return true;
+}
+
+bool editorPagerFind(EditorFile* file, const char* query, int direction) {
+  const char* map = file->map.data;
+  const char* end = map + file->map.size;
+  const char* cursor = editorGetRow(file, file->cursor.y)->data +
+                       file->cursor.x;
+
+  const char* match;
+  if (direction < 0) {
+    match = strCaseStrBefore(map, cursor, end, query);
+  } else {
+    const char* from = (direction > 0 && cursor < end) ? cursor + 1 : cursor;
+    match = strCaseStr(from, end - from, query);
+  }
+  if (!match) return false;
+
+  const char* line_start = match;
+  while (line_start > map && line_start[-1] != '\n') line_start--;
+
+  int64_t line = pagerLineAt(file, line_start);
+  int index = pagerLoadAround(file, line_start - map, line);
+  pagerMoveCursor(file, index, match - line_start);
+  return true;
+}
@@ -0,0 +1,34 @@
+#ifndef PAGER_H
+#define PAGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Files bigger than this part of the memory are opened in view mode
+#define EDITOR_VIEW_MEMORY_RATIO 4
+// Line indexes of files at least this big are cached under CONF_DIR
+#define EDITOR_INDEX_CACHE_SIZE (64 << 20)
+
+typedef struct EditorFile EditorFile;
+typedef struct EditorPager EditorPager;
+
+// View mode only keeps a window of rows around the screen, file->row[0] is
+// some line in the middle of the file.
+bool editorStartPager(EditorFile* file);
+void editorFreePager(EditorFile* file);
+bool editorPollPager(EditorFile* file);
+int editorPagerProgress(EditorFile* file);
+
+// Line number of row y, 0 if it's not known yet
+int64_t editorGetLineNumber(const EditorFile* file, int y);
+// -1 if the file hasn't been indexed yet
+int64_t editorPagerLineCount(EditorFile* file);
+
+// Move the window when the screen gets close to its edges
+void editorPagerSlide(EditorFile* file);
+void editorPagerSeekStart(EditorFile* file);
+void editorPagerSeekEnd(EditorFile* file);
+bool editorPagerGoto(EditorFile* file, int64_t line);
+bool editorPagerFind(EditorFile* file, const char* query, int direction);
+
+#endif
@@ -0,0 +1,76 @@
+#include "piece.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+struct EditorAddBlock {
+  EditorAddBlock* next;
+  size_t used;
+  size_t size;
+  char data[];
+};
+
+static EditorAddBlock* addNewBlock(size_t size) {
+  EditorAddBlock* block = malloc_s(sizeof(EditorAddBlock) + size);
+  block->used = 0;
+  block->size = size;
+  return block;
+}
+
+char* editorAddText(EditorAddBuffer* buf, const char* s, size_t len) {
+  EditorAddBlock* head = buf->head;
+  size_t need = len + 1;
+
+  if (!head || head->size - head->used < need) {
+    if (need > EDITOR_ADD_BLOCK_SIZE / 4) {
+      // Goes behind the head, so what's left of the head still gets used
+      EditorAddBlock* block = addNewBlock(need);
+      if (head) {
+        block->next = head->next;
+        head->next = block;
+      } else {
+        block->next = NULL;
+        buf->head = block;
+      }
+      head = block;
+    } else {
+      head = addNewBlock(EDITOR_ADD_BLOCK_SIZE);
+      head->next = buf->head;
+      buf->head = head;
+    }
+  }
+
+  char* text = &head->data[head->used];
+  memcpy(text, s, len);
+  text[len] = '\0';
+  head->used += need;
+  return text;
+}
+
+void editorTakeAddBuffer(EditorAddBuffer* buf, EditorAddBuffer* from) {
+  EditorAddBlock* first = from->head;
+  if (!first) return;
+  from->head = NULL;
+
+  EditorAddBlock* last = first;
+  while (last->next) last = last->next;
+  // Behind the head, so it keeps getting filled
+  if (buf->head) {
+    last->next = buf->head->next;
+    buf->head->next = first;
+  } else {
+    buf->head = first;
+  }
+}
+
+void editorFreeAddBuffer(EditorAddBuffer* buf) {
+  EditorAddBlock* block = buf->head;
+  while (block) {
+    EditorAddBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+  buf->head = NULL;
+}
@@ -0,0 +1,30 @@
+#ifndef PIECE_H
+#define PIECE_H
+
+#include <stddef.h>
+
+// Rows are pieces of text that stays where it is: the file mapping for the
+// lines that were loaded and an append-only add buffer for the lines that
+// were inserted, like the two buffers of a piece table. Lines that aren't
+// in the mapping when they are loaded, because they were decompressed,
+// converted or read from a pipe, are added to the add buffer too. Neither
+// is written to, so loading and inserting lines costs no allocation per
+// line and a row only gets its own copy when it's edited.
+
+// Text longer than a quarter of this gets a block of its own
+#define EDITOR_ADD_BLOCK_SIZE (256 << 10)
+
+typedef struct EditorAddBlock EditorAddBlock;
+
+typedef struct EditorAddBuffer {
+  // The block being filled is first
+  EditorAddBlock* head;
+} EditorAddBuffer;
+
+// Copy of s with a NUL after it, valid until the buffer is freed
+char* editorAddText(EditorAddBuffer* buf, const char* s, size_t len);
+// Moves the blocks of from to buf, text written to from stays valid
+void editorTakeAddBuffer(EditorAddBuffer* buf, EditorAddBuffer* from);
+void editorFreeAddBuffer(EditorAddBuffer* buf);
+
+#endif
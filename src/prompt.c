@@ -1,6 +1,7 @@
 #include "prompt.h"
 
 #include <ctype.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
@@ -153,7 +154,8 @@ char* editorPrompt(char* prompt, int state, void (*callback)(char*, int)) {
         } else if (field == FIELD_TEXT) {
           mousePosToEditorPos(&x, &y);
           current_file->cursor.y = y;
-          current_file->cursor.x = editorRowRxToCx(&current_file->row[y], x);
+          current_file->cursor.x =
+              editorRowRxToCx(editorGetRow(current_file, y), x);
           current_file->sx = x;
         }
       }
@@ -215,8 +217,42 @@ static void editorGotoCallback(char* query, int key) {
     return;
   }
 
+  if (current_file->hex) {
+    // Hex with 0x in front, decimal otherwise
+    int base = (query[0] == '0' && (query[1] == 'x' || query[1] == 'X')) ? 16
+                                                                          : 10;
+    char* end;
+    errno = 0;
+    unsigned long long offset = strtoull(query, &end, base);
+    if (*end != '\0' || errno || query[0] == '-' ||
+        !editorHexGoto(current_file, offset)) {
+      editorMsg("Type an offset between 0 to 0x%llx.",
+                (unsigned long long)(current_file->map.size - 1));
+    }
+    return;
+  }
+
   int line = strToInt(query);
 
+  if (current_file->pager) {
+    int64_t count = editorPagerLineCount(current_file);
+    if (line < 0 && count < 0) {
+      editorMsg("Lines are still being counted, type a positive number.");
+      return;
+    }
+
+    int64_t target = (line < 0) ? count + 1 + line : line;
+    if (target > 0 && editorPagerGoto(current_file, target - 1)) {
+      editorScrollToCursorCenter();
+    } else if (count > 0) {
+      editorMsg("Type a line number between 1 to %lld (negative too).",
+                (long long)count);
+    } else {
+      editorMsg("Line %d is past the end of the file.", line);
+    }
+    return;
+  }
+
   if (line < 0) {
     line = current_file->num_rows + 1 + line;
   }
@@ -233,8 +269,8 @@ static void editorGotoCallback(char* query, int key) {
 }
 
 void editorGotoLine(void) {
-  char* query =
-      editorPrompt("Goto line: %s", GOTO_LINE_MODE, editorGotoCallback);
+  char* prompt = current_file->hex ? "Goto offset: %s" : "Goto line: %s";
+  char* query = editorPrompt(prompt, GOTO_LINE_MODE, editorGotoCallback);
   if (query) {
     free(query);
   }
@@ -285,6 +321,23 @@ static void editorFindCallback(char* query, int key) {
     return;
   }
 
+  // Search the file itself from the cursor
+  if (current_file->pager || current_file->hex) {
+    int direction = 0;
+    if (key == ARROW_DOWN) direction = 1;
+    if (key == ARROW_UP) direction = -1;
+    bool found = current_file->hex
+                     ? editorHexFind(current_file, query, direction)
+                     : editorPagerFind(current_file, query, direction);
+    if (found) {
+      editorSetRightPrompt("");
+      if (current_file->pager) editorScrollToCursorCenter();
+    } else {
+      editorSetRightPrompt("  No results");
+    }
+    return;
+  }
+
   FindList* tail_node = NULL;
   if (!head.next || !prev_query || strcmp(prev_query, query) != 0) {
     // Recompute find list
@@ -303,14 +356,13 @@ static void editorFindCallback(char* query, int key) {
 
     FindList* cur = &head;
     for (int i = 0; i < current_file->num_rows; i++) {
+      const EditorRow* row = editorGetRow(current_file, i);
       char* match = NULL;
       int col = 0;
-      char* (*search_func)(const char*, const char*) = &strstr;
-      search_func = &strCaseStr;
 
-      while ((match = (*search_func)(&current_file->row[i].data[col], query)) !=
+      while ((match = strCaseStr(&row->data[col], row->size - col, query)) !=
              0) {
-        col = match - current_file->row[i].data;
+        col = match - row->data;
         FindList* node = malloc_s(sizeof(FindList));
 
         node->prev = cur;
@@ -0,0 +1,464 @@
+#include "reload.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compress.h"
+#include "editor.h"
+#include "encoding.h"
+#include "prompt.h"
+#include "utils.h"
+
+// Past this many inserted and deleted lines the diff stops looking for the
+// shortest edit, and everything left in between is replaced as one hunk
+#define RELOAD_MAX_EDITS 1024
+
+typedef struct ReloadLine {
+  const char* data;
+  int size;
+  uint64_t hash;
+} ReloadLine;
+
+// The file as it is on disk now, as UTF-8 lines
+typedef struct ReloadText {
+  FileInfo info;
+  FileMap map;
+  // Decompressed or converted copy, NULL when the lines are in the map
+  char* buf;
+  CompressType compress;
+  Encoding encoding;
+
+  ReloadLine* lines;
+  int count;
+  bool has_cr;
+} ReloadText;
+
+static void reloadSplitLines(ReloadText* text, const char* p, size_t len) {
+  const char* end = p + len;
+  size_t cap = 16;
+  text->lines = malloc_s(sizeof(ReloadLine) * cap);
+  text->count = 0;
+
+  // Ending with a newline leaves an empty last line, like the loader does
+  while (true) {
+    const char* nl = memchr(p, '\n', end - p);
+    const char* line_end = nl ? nl : end;
+    while (line_end > p && (line_end[-1] == '\r' || line_end[-1] == '\n')) {
+      if (line_end[-1] == '\r') text->has_cr = true;
+      line_end--;
+    }
+
+    if ((size_t)text->count >= cap) {
+      cap *= 2;
+      text->lines = realloc_s(text->lines, sizeof(ReloadLine) * cap);
+    }
+    ReloadLine* line = &text->lines[text->count++];
+    line->data = p;
+    line->size = line_end - p;
+    line->hash = hashBytes(line->data, line->size);
+
+    if (!nl) break;
+    p = nl + 1;
+  }
+}
+
+static bool reloadDecompress(ReloadText* text, const char* data, size_t len,
+                             abuf* out) {
+  if (!isCompressSupported(text->compress)) return false;
+  Decompressor* d = decompressStart(text->compress, data, len);
+  if (!d) return false;
+
+  const char* chunk;
+  int64_t n;
+  while ((n = decompressRead(d, &chunk)) > 0) {
+    abufAppendN(out, chunk, n);
+  }
+  decompressFree(d);
+  return n == 0;
+}
+
+static bool reloadRead(const char* filename, ReloadText* text) {
+  memset(text, 0, sizeof(ReloadText));
+  text->map.fd = -1;
+
+  FILE* fp = openFile(filename, "rb");
+  if (!fp) return false;
+  text->info = getFileInfo(filename);
+
+  // Files that can't be mapped, like empty ones, are read into buf
+  abuf ab = ABUF_INIT;
+  const char* data;
+  size_t len;
+  if (mapFile(&text->map, fp)) {
+    data = text->map.data;
+    len = text->map.size;
+  } else {
+    char chunk[8192];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+      abufAppendN(&ab, chunk, n);
+    }
+    data = ab.buf;
+    len = ab.len;
+  }
+  fclose(fp);
+
+  text->compress = getCompressType(data, len);
+  if (text->compress != COMPRESS_NONE) {
+    abuf out = ABUF_INIT;
+    if (!reloadDecompress(text, data, len, &out)) {
+      abufFree(&out);
+      abufFree(&ab);
+      unmapFile(&text->map);
+      errno = EILSEQ;
+      return false;
+    }
+    abufFree(&ab);
+    ab = out;
+    data = ab.buf;
+    len = ab.len;
+  }
+
+  size_t bom_len;
+  text->encoding = detectEncoding(data ? data : "", len, true, &bom_len);
+  data += bom_len;
+  len -= bom_len;
+
+  if (isTranscoded(text->encoding)) {
+    TextDecoder decoder = {.encoding = text->encoding};
+    char* decoded = malloc_s(decodeTextSize(len));
+    size_t n = decodeText(&decoder, data, len, decoded);
+    n += decodeTextFinish(&decoder, decoded + n);
+    abufFree(&ab);
+    ab.buf = decoded;
+    ab.len = n;
+    data = decoded;
+    len = n;
+  }
+
+  text->buf = ab.buf;
+  reloadSplitLines(text, data ? data : "", len);
+  return true;
+}
+
+static void reloadFreeText(ReloadText* text) {
+  free(text->lines);
+  free(text->buf);
+  unmapFile(&text->map);
+}
+
+// Diff
+
+static bool isSameLine(const ReloadLine* a, const ReloadLine* b) {
+  return a->hash == b->hash && a->size == b->size &&
+         memcmp(a->data, b->data, a->size) == 0;
+}
+
+// Myers' greedy diff of a[0, n) and b[0, m), marking the lines that are
+// only in one of them. The furthest reaching x of every diagonal is kept for
+// each edit count to walk the shortest path back. Returns false if it takes
+// more than RELOAD_MAX_EDITS edits.
+static bool diffMiddle(const ReloadLine* a, int n, const ReloadLine* b,
+                       int m, bool* a_changed, bool* b_changed) {
+  int max = n + m;
+  if (max > RELOAD_MAX_EDITS) max = RELOAD_MAX_EDITS;
+
+  int offset = max + 1;
+  int* v = calloc_s(2 * max + 3, sizeof(int));
+  int* trace = NULL;
+  size_t trace_len = 0;
+
+  int edits = -1;
+  for (int d = 0; d <= max && edits < 0; d++) {
+    for (int k = -d; k <= d; k += 2) {
+      int x;
+      if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) {
+        x = v[offset + k + 1];
+      } else {
+        x = v[offset + k - 1] + 1;
+      }
+      int y = x - k;
+      while (x < n && y < m && isSameLine(&a[x], &b[y])) {
+        x++;
+        y++;
+      }
+      v[offset + k] = x;
+      if (x >= n && y >= m) edits = d;
+    }
+
+    // Diagonals -d to d, so step d starts at d * d
+    trace = realloc_s(trace, sizeof(int) * (trace_len + 2 * d + 1));
+    memcpy(trace + trace_len, v + offset - d, sizeof(int) * (2 * d + 1));
+    trace_len += 2 * d + 1;
+  }
+  free(v);
+
+  if (edits < 0) {
+    free(trace);
+    return false;
+  }
+
+  int x = n;
+  int y = m;
+  for (int d = edits; d > 0; d--) {
+    // x of diagonal k after step d - 1
+    const int* prev = trace + (size_t)(d - 1) * (d - 1) + (d - 1);
+    int k = x - y;
+    int prev_k;
+    if (k == -d || (k != d && prev[k - 1] < prev[k + 1])) {
+      prev_k = k + 1;
+    } else {
+      prev_k = k - 1;
+    }
+    int prev_x = prev[prev_k];
+    int prev_y = prev_x - prev_k;
+
+    if (prev_k == k + 1) {
+      b_changed[prev_y] = true;
+    } else {
+      a_changed[prev_x] = true;
+    }
+    x = prev_x;
+    y = prev_y;
+  }
+  free(trace);
+  return true;
+}
+
+// Hunks of the lines that differ between the rows and the text
+static int diffLines(const ReloadLine* a, int n, const ReloadLine* b, int m,
+                     PatchHunk** hunks) {
+  int start = 0;
+  while (start < n && start < m && isSameLine(&a[start], &b[start])) start++;
+  int a_end = n;
+  int b_end = m;
+  while (a_end > start && b_end > start &&
+         isSameLine(&a[a_end - 1], &b[b_end - 1])) {
+    a_end--;
+    b_end--;
+  }
+
+  bool* a_changed = calloc_s(n + 1, sizeof(bool));
+  bool* b_changed = calloc_s(m + 1, sizeof(bool));
+  if (!diffMiddle(a + start, a_end - start, b + start, b_end - start,
+                  a_changed + start, b_changed + start)) {
+    memset(a_changed + start, true, a_end - start);
+    memset(b_changed + start, true, b_end - start);
+  }
+
+  // Unchanged lines pair up in order, so the runs of changed lines between
+  // them are the hunks
+  int count = 0;
+  int cap = 0;
+  *hunks = NULL;
+  int i = start;
+  int j = start;
+  while (i < a_end || j < b_end) {
+    if (i < a_end && j < b_end && !a_changed[i] && !b_changed[j]) {
+      i++;
+      j++;
+      continue;
+    }
+
+    if (count == cap) {
+      cap = cap ? cap * 2 : 8;
+      *hunks = realloc_s(*hunks, sizeof(PatchHunk) * cap);
+    }
+    PatchHunk* hunk = &(*hunks)[count++];
+    hunk->old_y = i;
+    hunk->new_y = j;
+    while (i < a_end && a_changed[i]) i++;
+    while (j < b_end && b_changed[j]) j++;
+    // Only the line counts for now
+    hunk->old_lines.size = i - hunk->old_y;
+    hunk->new_lines.size = j - hunk->new_y;
+  }
+
+  free(a_changed);
+  free(b_changed);
+  return count;
+}
+
+// Where row y ends up after the patch. Rows inside a replaced hunk stay at
+// the same offset into it as far as it goes.
+static int mapRowThroughPatch(const PatchAction* patch, int y) {
+  int shift = 0;
+  for (int i = 0; i < patch->count; i++) {
+    const PatchHunk* hunk = &patch->hunks[i];
+    int old_count = hunk->old_lines.size;
+    int new_count = hunk->new_lines.size;
+    if (y < hunk->old_y) break;
+    if (y < hunk->old_y + old_count) {
+      int offset = y - hunk->old_y;
+      if (offset >= new_count) offset = new_count ? new_count - 1 : 0;
+      return hunk->new_y + offset;
+    }
+    shift = hunk->new_y + new_count - (hunk->old_y + old_count);
+  }
+  return y + shift;
+}
+
+// Reload
+
+static bool canReload(const EditorFile* file) {
+  return file->filename && !file->loader && !file->saver && !file->pager &&
+         !file->hex && !file->follow && !file->stream && !file->session;
+}
+
+// Rows that didn't change still point into the old mapping. When the new
+// text is mapped as it is, every row is moved to it and the old one is
+// dropped.
+static void reloadSwapMap(EditorFile* file, ReloadText* text) {
+  if (text->buf) return;
+
+  for (int i = 0; i < file->num_rows; i++) {
+    EditorRow* row = editorGetRow(file, i);
+    editorFreeRow(file, row);
+    row->data = (char*)text->lines[i].data;
+    row->mapped = true;
+  }
+  unmapFile(&file->map);
+  file->map = text->map;
+  text->map.data = NULL;
+  text->map.fd = -1;
+}
+
+static void reloadText(EditorFile* file, ReloadText* text) {
+  ReloadLine* rows = malloc_s(sizeof(ReloadLine) * file->num_rows);
+  for (int i = 0; i < file->num_rows; i++) {
+    const EditorRow* row = editorGetRow(file, i);
+    rows[i].data = row->data;
+    rows[i].size = row->size;
+    rows[i].hash = hashBytes(rows[i].data, rows[i].size);
+  }
+
+  int new_newline = file->newline;
+  if (text->has_cr) {
+    new_newline = NL_DOS;
+  } else if (text->count > 1) {
+    new_newline = NL_UNIX;
+  }
+
+  PatchHunk* hunks;
+  int count = diffLines(rows, file->num_rows, text->lines, text->count,
+                        &hunks);
+  free(rows);
+
+  if (count || new_newline != file->newline) {
+    EditorAction* action = calloc_s(1, sizeof(EditorAction));
+    action->type = ACTION_PATCH;
+    PatchAction* patch = &action->patch;
+    patch->count = count;
+    patch->hunks = hunks;
+    patch->old_newline = file->newline;
+    patch->new_newline = new_newline;
+    patch->old_cursor = file->cursor;
+
+    for (int i = 0; i < count; i++) {
+      PatchHunk* hunk = &hunks[i];
+      editorCopyRows(&hunk->old_lines, file, hunk->old_y,
+                     hunk->old_lines.size);
+
+      EditorClipboard* lines = &hunk->new_lines;
+      lines->data = lines->size ? malloc_s(sizeof(char*) * lines->size) : NULL;
+      for (size_t j = 0; j < lines->size; j++) {
+        const ReloadLine* line = &text->lines[hunk->new_y + j];
+        lines->data[j] = malloc_s(line->size + 1);
+        memcpy(lines->data[j], line->data, line->size);
+        lines->data[j][line->size] = '\0';
+      }
+    }
+
+    // Keep the cursor on the same line and screen column, and the same line
+    // at the top of the screen
+    EditorCursor* cursor = &file->cursor;
+    int rx = editorRowCxToRx(editorGetRow(file, cursor->y), cursor->x);
+    int cursor_y = mapRowThroughPatch(patch, cursor->y);
+    int row_offset = mapRowThroughPatch(patch, file->row_offset);
+
+    editorApplyPatch(file, patch, false);
+    file->newline = new_newline;
+
+    if (cursor_y >= file->num_rows) cursor_y = file->num_rows - 1;
+    if (row_offset >= file->num_rows) row_offset = file->num_rows - 1;
+    cursor->y = cursor_y;
+    cursor->x = editorRowRxToCx(editorGetRow(file, cursor_y), rx);
+    cursor->is_selected = false;
+    file->row_offset = row_offset;
+    patch->new_cursor = *cursor;
+
+    // The buffer is the file on disk now, older unsaved edits are in the
+    // undo history only
+    editorFreeJournal(file);
+    file->file_info = text->info;
+    editorPushAction(action);
+    file->dirty = 0;
+
+    editorMsg("\"%s\" changed on disk and was reloaded, ^Z undoes it.",
+              getBaseName(file->filename));
+  } else {
+    free(hunks);
+    editorFreeJournal(file);
+    file->file_info = text->info;
+    file->dirty = 0;
+    editorMsg("\"%s\" is the same as on disk.", getBaseName(file->filename));
+  }
+
+  file->compress = text->compress;
+  file->encoding = text->encoding;
+  reloadSwapMap(file, text);
+}
+
+static bool editorReload(EditorFile* file) {
+  ReloadText text;
+  if (!reloadRead(file->filename, &text)) {
+    editorMsg("Can't reload \"%s\"! %s", file->filename, strerror(errno));
+    return false;
+  }
+
+  // editorPushAction works on the current file
+  EditorFile* prev_file = current_file;
+  current_file = file;
+  reloadText(file, &text);
+  current_file = prev_file;
+
+  reloadFreeText(&text);
+  return true;
+}
+
+bool editorPollReload(EditorFile* file) {
+  if (!canReload(file)) return false;
+
+  FileInfo info = getFileInfo(file->filename);
+  FileStamp stamp = getFileStamp(info);
+  if (areStampsEqual(stamp, file->disk_stamp)) return false;
+  file->disk_stamp = stamp;
+  if (areStampsEqual(stamp, getFileStamp(file->file_info))) return false;
+
+  if (info.error) {
+    editorMsg("\"%s\" was deleted or moved.", getBaseName(file->filename));
+  } else if (file->dirty) {
+    editorMsg("\"%s\" changed on disk, ^R reloads it.",
+              getBaseName(file->filename));
+  } else {
+    editorReload(file);
+  }
+  return true;
+}
+
+void editorReloadFile(EditorFile* file) {
+  if (!file->filename) {
+    editorMsg("Only files on disk can be reloaded.");
+  } else if (file->loader || file->session) {
+    editorMsg("Can't reload while the file is still loading.");
+  } else if (file->saver) {
+    editorMsg("Can't reload while the file is being saved.");
+  } else if (file->pager || file->hex) {
+    editorMsg("Can't reload in view mode.");
+  } else if (file->follow || file->stream) {
+    editorMsg("Can't reload while following the file.");
+  } else {
+    editorReload(file);
+  }
+}
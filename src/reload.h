@@ -0,0 +1,17 @@
+#ifndef RELOAD_H
+#define RELOAD_H
+
+#include <stdbool.h>
+
+typedef struct EditorFile EditorFile;
+
+// A file changed by another program is diffed line by line against the
+// rows, and only the lines that differ are replaced. The reload is a single
+// undo step, so ^Z brings back what was in the buffer.
+
+// Reloads the current file if it changed on disk and has no unsaved edits,
+// otherwise tells about the change once
+bool editorPollReload(EditorFile* file);
+void editorReloadFile(EditorFile* file);
+
+#endif
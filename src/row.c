@@ -5,84 +5,139 @@
 
 #include "defines.h"
 #include "editor.h"
+#include "scan.h"
 #include "unicode.h"
 #include "utils.h"
 
 void editorUpdateRow(EditorRow* row) {
-  row->rsize = editorRowCxToRx(row, row->size);
+  int flags = scanText(row->data, row->size);
+  row->ascii = !(flags & LINE_NON_ASCII);
+  row->plain = !flags;
+}
+
+void editorInitRow(EditorFile* file, EditorRow* row, const char* s,
+                   size_t len) {
+  row->size = len;
+  row->data = editorAddText(&file->add, s, len);
+  row->mapped = true;
+
+  editorUpdateRow(row);
 }
 
 void editorInsertRow(EditorFile* file, int at, const char* s, size_t len) {
   if (at < 0 || at > file->num_rows) return;
+  EditorRow row;
+  editorInitRow(file, &row, s, len);
+  editorSpliceRows(file, at, 0, &row, 1);
+  file->lineno_width = getDigit(file->num_rows) + 2;
+}
 
-  file->row = realloc_s(file->row, sizeof(EditorRow) * (file->num_rows + 1));
-  memmove(&file->row[at + 1], &file->row[at],
-          sizeof(EditorRow) * (file->num_rows - at));
+void editorInsertRows(EditorFile* file, int at, char* const* lines,
+                      int count) {
+  if (at < 0 || at > file->num_rows || count <= 0) return;
+  EditorRow* rows = malloc_s(sizeof(EditorRow) * count);
+  for (int i = 0; i < count; i++) {
+    editorInitRow(file, &rows[i], lines[i], strlen(lines[i]));
+  }
+  editorSpliceRows(file, at, 0, rows, count);
+  free(rows);
+  file->lineno_width = getDigit(file->num_rows) + 2;
+}
 
-  file->row[at].size = len;
-  file->row[at].data = malloc_s(len + 1);
-  memcpy(file->row[at].data, s, len);
-  file->row[at].data[len] = '\0';
+void editorFreeRow(EditorFile* file, EditorRow* row) {
+  if (!row->mapped) editorFreeRowText(file, row->data, row->size + 1);
+}
 
-  editorUpdateRow(&file->row[at]);
+void editorRowCopyOnWrite(EditorFile* file, EditorRow* row) {
+  if (!row->mapped) return;
 
-  file->num_rows++;
-  file->lineno_width = getDigit(file->num_rows) + 2;
+  char* data = editorResizeRowText(file, NULL, 0, row->size + 1);
+  memcpy(data, row->data, row->size);
+  data[row->size] = '\0';
+  row->data = data;
+  row->mapped = false;
 }
 
-void editorFreeRow(EditorRow* row) { free(row->data); }
-
 void editorDelRow(EditorFile* file, int at) {
   if (at < 0 || at >= file->num_rows) return;
-  editorFreeRow(&file->row[at]);
-  memmove(&file->row[at], &file->row[at + 1],
-          sizeof(EditorRow) * (file->num_rows - at - 1));
+  editorDelRows(file, at, 1);
+}
 
-  file->num_rows--;
+void editorDelRows(EditorFile* file, int at, int count) {
+  if (at < 0 || count <= 0 || at + count > file->num_rows) return;
+  for (int i = 0; i < count; i++) {
+    editorFreeRow(file, editorGetRow(file, at + i));
+  }
+  editorSpliceRows(file, at, count, NULL, 0);
   file->lineno_width = getDigit(file->num_rows) + 2;
 }
 
-void editorRowInsertChar(EditorRow* row, int at, int c) {
-  if (at < 0 || at > row->size) at = row->size;
-  row->data = realloc_s(row->data, row->size + 2);
-  memmove(&row->data[at + 1], &row->data[at], row->size - at + 1);
-  row->size++;
-  row->data[at] = c;
-  editorUpdateRow(row);
+// Text of a row that isn't mapped always fills size + 1 bytes of its slab
+static void editorRowResize(EditorFile* file, EditorRow* row, int size) {
+  row->data =
+      editorResizeRowText(file, row->data, row->size + 1, (size_t)size + 1);
 }
 
-void editorRowDelChar(EditorRow* row, int at) {
+void editorRowDelChar(EditorFile* file, EditorRow* row, int at) {
   if (at < 0 || at >= row->size) return;
+  editorRowCopyOnWrite(file, row);
   memmove(&row->data[at], &row->data[at + 1], row->size - at);
+  editorRowResize(file, row, row->size - 1);
   row->size--;
   editorUpdateRow(row);
 }
 
-void editorRowAppendString(EditorRow* row, const char* s, size_t len) {
-  row->data = realloc_s(row->data, row->size + len + 1);
+void editorRowAppendString(EditorFile* file, EditorRow* row, const char* s,
+                           size_t len) {
+  editorRowCopyOnWrite(file, row);
+  editorRowResize(file, row, row->size + len);
   memcpy(&row->data[row->size], s, len);
   row->size += len;
   row->data[row->size] = '\0';
   editorUpdateRow(row);
 }
 
-void editorInsertChar(int c) {
+void editorRowInsertString(EditorFile* file, EditorRow* row, int at,
+                           const char* s, size_t len) {
+  if (at < 0 || at > row->size) at = row->size;
+  editorRowCopyOnWrite(file, row);
+  editorRowResize(file, row, row->size + len);
+  memmove(&row->data[at + len], &row->data[at], row->size - at);
+  memcpy(&row->data[at], s, len);
+  row->size += len;
+  row->data[row->size] = '\0';
+  editorUpdateRow(row);
+}
+
+void editorRowTruncate(EditorFile* file, EditorRow* row, int size) {
+  if (size < 0 || size >= row->size) return;
+  if (!row->mapped) {
+    editorRowResize(file, row, size);
+    row->data[size] = '\0';
+  }
+  row->size = size;
+  editorUpdateRow(row);
+}
+
+static void editorInsertText(const char* s, int len) {
   if (current_file->cursor.y == current_file->num_rows) {
     editorInsertRow(current_file, current_file->num_rows, "", 0);
   }
-  editorRowInsertChar(&current_file->row[current_file->cursor.y],
-                      current_file->cursor.x, c);
-  current_file->cursor.x++;
+  editorGapInsertString(current_file, current_file->cursor.y,
+                        current_file->cursor.x, s, len);
+  current_file->cursor.x += len;
+}
+
+void editorInsertChar(int c) {
+  char ch = c;
+  editorInsertText(&ch, 1);
 }
 
 void editorInsertUnicode(uint32_t unicode) {
   char output[4];
   int len = encodeUTF8(unicode, output);
   if (len == -1) return;
-
-  for (int i = 0; i < len; i++) {
-    editorInsertChar(output[i]);
-  }
+  editorInsertText(output, len);
 }
 
 void editorInsertNewline(void) {
@@ -91,37 +146,39 @@ void editorInsertNewline(void) {
   if (current_file->cursor.x == 0) {
     editorInsertRow(current_file, current_file->cursor.y, "", 0);
   } else {
-    editorInsertRow(current_file, current_file->cursor.y + 1, "", 0);
-    EditorRow* curr_row = &current_file->row[current_file->cursor.y];
-    EditorRow* new_row = &current_file->row[current_file->cursor.y + 1];
-    editorRowAppendString(new_row, &curr_row->data[current_file->cursor.x],
-                          curr_row->size - current_file->cursor.x);
-    curr_row->size = current_file->cursor.x;
-    curr_row->data[curr_row->size] = '\0';
-    editorUpdateRow(curr_row);
+    // Row data doesn't move when the rows do
+    const EditorRow* row = editorGetRow(current_file, current_file->cursor.y);
+    editorInsertRow(current_file, current_file->cursor.y + 1,
+                    &row->data[current_file->cursor.x],
+                    row->size - current_file->cursor.x);
+    editorRowTruncate(current_file,
+                      editorGetRow(current_file, current_file->cursor.y),
+                      current_file->cursor.x);
   }
   current_file->cursor.y++;
   current_file->cursor.x = i;
   current_file->sx =
-      editorRowCxToRx(&current_file->row[current_file->cursor.y], i);
+      editorRowCxToRx(editorGetRow(current_file, current_file->cursor.y), i);
 }
 
 void editorDelChar(void) {
   if (current_file->cursor.y == current_file->num_rows) return;
   if (current_file->cursor.x == 0 && current_file->cursor.y == 0) return;
-  EditorRow* row = &current_file->row[current_file->cursor.y];
   if (current_file->cursor.x > 0) {
-    editorRowDelChar(row, current_file->cursor.x - 1);
+    editorGapDelChar(current_file, current_file->cursor.y,
+                     current_file->cursor.x - 1);
     current_file->cursor.x--;
   } else {
-    current_file->cursor.x = current_file->row[current_file->cursor.y - 1].size;
-    editorRowAppendString(&current_file->row[current_file->cursor.y - 1],
-                          row->data, row->size);
+    EditorRow* row = editorGetRow(current_file, current_file->cursor.y);
+    EditorRow* prev = editorGetRow(current_file, current_file->cursor.y - 1);
+    current_file->cursor.x = prev->size;
+    editorRowAppendString(current_file, prev, row->data, row->size);
     editorDelRow(current_file, current_file->cursor.y);
     current_file->cursor.y--;
   }
-  current_file->sx = editorRowCxToRx(&current_file->row[current_file->cursor.y],
-                                     current_file->cursor.x);
+  current_file->sx =
+      editorRowCxToRx(editorPeekRow(current_file, current_file->cursor.y),
+                      current_file->cursor.x);
 }
 
 int editorRowNextUTF8(EditorRow* row, int cx) {
@@ -129,6 +186,8 @@ int editorRowNextUTF8(EditorRow* row, int cx) {
 
   if (cx >= row->size) return row->size;
 
+  if (row->ascii) return cx + 1;
+
   const char* s = &row->data[cx];
   size_t byte_size;
   decodeUTF8(s, row->size - cx, &byte_size);
@@ -140,6 +199,8 @@ int editorRowPreviousUTF8(EditorRow* row, int cx) {
 
   if (cx > row->size) return row->size;
 
+  if (row->ascii) return cx - 1;
+
   int i = 0;
   size_t byte_size = 0;
   while (i < cx) {
@@ -149,8 +210,25 @@ int editorRowPreviousUTF8(EditorRow* row, int cx) {
   return i - byte_size;
 }
 
+static int asciiWidth(char c, int rx) {
+  if (c == '\t') return (TABSIZE - 1) - (rx % TABSIZE) + 1;
+  // Same as unicodeWidth(0)
+  if (c == '\0') return 0;
+  return 1;
+}
+
 int editorRowCxToRx(const EditorRow* row, int cx) {
+  if (cx <= 0) return 0;
+  if (row->plain) return (cx < row->size) ? cx : row->size;
+
   int rx = 0;
+  if (row->ascii) {
+    for (int i = 0; i < cx; i++) {
+      rx += asciiWidth(row->data[i], rx);
+    }
+    return rx;
+  }
+
   int i = 0;
   while (i < cx) {
     size_t byte_size;
@@ -168,8 +246,18 @@ int editorRowCxToRx(const EditorRow* row, int cx) {
 }
 
 int editorRowRxToCx(const EditorRow* row, int rx) {
+  if (row->plain) return (rx <= 0) ? 0 : (rx < row->size) ? rx : row->size;
+
   int cur_rx = 0;
   int cx = 0;
+  if (row->ascii) {
+    for (; cx < row->size; cx++) {
+      cur_rx += asciiWidth(row->data[cx], cur_rx);
+      if (cur_rx > rx) return cx;
+    }
+    return cx;
+  }
+
   while (cx < row->size) {
     size_t byte_size;
     uint32_t unicode = decodeUTF8(&row->data[cx], row->size - cx, &byte_size);
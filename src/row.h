@@ -8,19 +8,40 @@
 struct EditorFile;
 typedef struct EditorFile EditorFile;
 
+// 16 bytes, the rows of a leaf block take 4 KB. Text isn't kept in the row
+// even when it's short, rows move around in the tree while their text stays
+// put and loaded text is already in the mapping. Widths are worked out from
+// the text when they're needed, the flags keep that cheap.
 typedef struct EditorRow {
-  int size;
-  int rsize;
   char* data;
+  int size;
+  // data points into the file mapping or the add buffer and must be copied
+  // before writing, otherwise it's in the slabs of the file
+  bool mapped;
+  bool ascii;
+  // ASCII without tabs or NULs, every byte is one column
+  bool plain;
 } EditorRow;
 
 void editorUpdateRow(EditorRow* row);
+// Set an unused row to a copy of s in the add buffer
+void editorInitRow(EditorFile* file, EditorRow* row, const char* s,
+                   size_t len);
 void editorInsertRow(EditorFile* file, int at, const char* s, size_t len);
-void editorFreeRow(EditorRow* row);
+// Same for many lines, the rows after them are only moved once
+void editorInsertRows(EditorFile* file, int at, char* const* lines,
+                      int count);
+void editorFreeRow(EditorFile* file, EditorRow* row);
 void editorDelRow(EditorFile* file, int at);
-void editorRowInsertChar(EditorRow* row, int at, int c);
-void editorRowDelChar(EditorRow* row, int at);
-void editorRowAppendString(EditorRow* row, const char* s, size_t len);
+void editorDelRows(EditorFile* file, int at, int count);
+void editorRowDelChar(EditorFile* file, EditorRow* row, int at);
+void editorRowAppendString(EditorFile* file, EditorRow* row, const char* s,
+                           size_t len);
+void editorRowInsertString(EditorFile* file, EditorRow* row, int at,
+                           const char* s, size_t len);
+// Mapped rows are shortened without copying
+void editorRowTruncate(EditorFile* file, EditorRow* row, int size);
+void editorRowCopyOnWrite(EditorFile* file, EditorRow* row);
 
 // On current_file
 void editorInsertChar(int c);
@@ -0,0 +1,508 @@
+#include "rowtree.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+#include "scan.h"
+#include "slab.h"
+#include "utils.h"
+
+// Nodes this empty are merged with a neighbor when they fit together
+#define ROW_LEAF_MIN (EDITOR_ROW_LEAF_MAX / 4)
+#define ROW_NODE_MIN (EDITOR_ROW_NODE_MAX / 4)
+
+typedef struct RowNode {
+  bool leaf;
+  // Rows of a leaf, children of an inner node
+  int count;
+} RowNode;
+
+typedef struct RowLeaf {
+  RowNode node;
+  EditorRow rows[EDITOR_ROW_LEAF_MAX];
+} RowLeaf;
+
+typedef struct RowInner {
+  RowNode node;
+  // Rows under every child
+  int sizes[EDITOR_ROW_NODE_MAX];
+  RowNode* children[EDITOR_ROW_NODE_MAX];
+} RowInner;
+
+struct EditorRowTree {
+  RowNode* root;
+
+  // Leaf of the last row found and the index of its first row
+  RowLeaf* cache;
+  int cache_start;
+
+  // Typing leaves a gap in one row, its data is the text before the gap,
+  // gap_size unused bytes and the text after it. No gap when the size is 0.
+  int gap_y;
+  int gap_x;
+  int gap_size;
+
+  // Text of the rows that were edited
+  EditorSlabs slabs;
+};
+
+static RowLeaf* newLeaf(void) {
+  RowLeaf* leaf = malloc_s(sizeof(RowLeaf));
+  leaf->node.leaf = true;
+  leaf->node.count = 0;
+  return leaf;
+}
+
+static RowInner* newInner(void) {
+  RowInner* inner = malloc_s(sizeof(RowInner));
+  inner->node.leaf = false;
+  inner->node.count = 0;
+  return inner;
+}
+
+static int nodeSize(const RowNode* node) {
+  if (node->leaf) return node->count;
+  const RowInner* inner = (const RowInner*)node;
+  int size = 0;
+  for (int i = 0; i < node->count; i++) size += inner->sizes[i];
+  return size;
+}
+
+static void freeNode(RowNode* node) {
+  if (!node->leaf) {
+    RowInner* inner = (RowInner*)node;
+    for (int i = 0; i < node->count; i++) freeNode(inner->children[i]);
+  }
+  free(node);
+}
+
+// Only rows too long for a slab have text of their own
+static void freeNodeRows(RowNode* node) {
+  if (node->leaf) {
+    RowLeaf* leaf = (RowLeaf*)node;
+    for (int i = 0; i < node->count; i++) {
+      const EditorRow* row = &leaf->rows[i];
+      if (!row->mapped && row->size + 1 > EDITOR_SLAB_MAX) free(row->data);
+    }
+  } else {
+    RowInner* inner = (RowInner*)node;
+    for (int i = 0; i < node->count; i++) freeNodeRows(inner->children[i]);
+  }
+}
+
+static EditorRow* findRow(EditorRowTree* tree, int y) {
+  if (tree->cache && y >= tree->cache_start &&
+      y - tree->cache_start < tree->cache->node.count) {
+    return &tree->cache->rows[y - tree->cache_start];
+  }
+
+  RowNode* node = tree->root;
+  int start = 0;
+  while (!node->leaf) {
+    RowInner* inner = (RowInner*)node;
+    int i = 0;
+    while (i < node->count - 1 && y - start >= inner->sizes[i]) {
+      start += inner->sizes[i];
+      i++;
+    }
+    node = inner->children[i];
+  }
+
+  tree->cache = (RowLeaf*)node;
+  tree->cache_start = start;
+  return &tree->cache->rows[y - start];
+}
+
+static bool walkNode(const RowNode* node, int skip, EditorRowVisit visit,
+                     void* arg) {
+  if (node->leaf) {
+    const RowLeaf* leaf = (const RowLeaf*)node;
+    for (int i = skip; i < node->count; i++) {
+      if (!visit(&leaf->rows[i], arg)) return false;
+    }
+    return true;
+  }
+
+  const RowInner* inner = (const RowInner*)node;
+  for (int i = 0; i < node->count; i++) {
+    if (skip >= inner->sizes[i]) {
+      skip -= inner->sizes[i];
+      continue;
+    }
+    if (!walkNode(inner->children[i], skip, visit, arg)) return false;
+    skip = 0;
+  }
+  return true;
+}
+
+void editorWalkRows(const EditorRowTree* rows, int y, EditorRowVisit visit,
+                    void* arg) {
+  if (rows->root && y >= 0) walkNode(rows->root, y, visit, arg);
+}
+
+static void closeGap(EditorRowTree* tree) {
+  if (!tree->gap_size) return;
+  EditorRow* row = findRow(tree, tree->gap_y);
+  int x = tree->gap_x;
+  // With the '\0' at the end
+  memmove(&row->data[x], &row->data[x + tree->gap_size], row->size - x + 1);
+  row->data = editorSlabRealloc(&tree->slabs, row->data,
+                                row->size + tree->gap_size + 1, row->size + 1);
+  tree->gap_size = 0;
+}
+
+EditorRow* editorGetRow(const EditorFile* file, int y) {
+  EditorRowTree* tree = file->rows;
+  if (y < 0 || y >= file->num_rows) return NULL;
+  if (tree->gap_size && y == tree->gap_y) closeGap(tree);
+  return findRow(tree, y);
+}
+
+EditorRow* editorPeekRow(const EditorFile* file, int y) {
+  if (y < 0 || y >= file->num_rows) return NULL;
+  return findRow(file->rows, y);
+}
+
+static void copyText(EditorRowTree* tree, int y, int at, int len, char* out) {
+  const char* data = findRow(tree, y)->data;
+  if (!tree->gap_size || y != tree->gap_y) {
+    memcpy(out, &data[at], len);
+    return;
+  }
+
+  int before = (at < tree->gap_x) ? tree->gap_x - at : 0;
+  if (before > len) before = len;
+  memcpy(out, &data[at], before);
+  memcpy(&out[before], &data[at + before + tree->gap_size], len - before);
+}
+
+void editorCopyRowText(const EditorFile* file, int y, int at, int len,
+                       char* out) {
+  copyText(file->rows, y, at, len, out);
+}
+
+char* editorResizeRowText(const EditorFile* file, char* data,
+                          size_t old_size, size_t size) {
+  return editorSlabRealloc(&file->rows->slabs, data, old_size, size);
+}
+
+void editorFreeRowText(const EditorFile* file, char* data, size_t size) {
+  editorSlabFree(&file->rows->slabs, data, size);
+}
+
+void editorCloseRowGap(const EditorFile* file, int y) {
+  EditorRowTree* tree = file->rows;
+  if (tree && tree->gap_size && tree->gap_y != y) closeGap(tree);
+}
+
+// Put a gap of at least size bytes at x in row y
+static EditorRow* openGap(EditorRowTree* tree, int y, int x, int size) {
+  if (tree->gap_size && tree->gap_y != y) closeGap(tree);
+  EditorRow* row = findRow(tree, y);
+
+  if (tree->gap_size >= size && tree->gap_size > 0) {
+    char* data = row->data;
+    int gap_x = tree->gap_x;
+    if (x < gap_x) {
+      memmove(&data[x + tree->gap_size], &data[x], gap_x - x);
+    } else {
+      memmove(&data[gap_x], &data[gap_x + tree->gap_size], x - gap_x);
+    }
+    tree->gap_x = x;
+    return row;
+  }
+
+  // Grows with the row, so refilling it costs O(1) a byte
+  int gap_size = size + row->size / 8;
+  if (gap_size < EDITOR_ROW_GAP_MIN) gap_size = EDITOR_ROW_GAP_MIN;
+
+  char* data = editorSlabAlloc(&tree->slabs, row->size + gap_size + 1);
+  copyText(tree, y, 0, x, data);
+  copyText(tree, y, x, row->size - x, &data[x + gap_size]);
+  data[row->size + gap_size] = '\0';
+  if (!row->mapped) {
+    editorSlabFree(&tree->slabs, row->data, row->size + tree->gap_size + 1);
+  }
+  row->data = data;
+  row->mapped = false;
+
+  tree->gap_y = y;
+  tree->gap_x = x;
+  tree->gap_size = gap_size;
+  return row;
+}
+
+void editorGapInsertString(EditorFile* file, int y, int at, const char* s,
+                           int len) {
+  EditorRowTree* tree = file->rows;
+  EditorRow* row = findRow(tree, y);
+  if (at < 0 || at > row->size) at = row->size;
+
+  // Widths after the text can depend on it, the row is edited in place
+  if (!row->plain || scanText(s, len)) {
+    row = editorGetRow(file, y);
+    editorRowInsertString(file, row, at, s, len);
+    return;
+  }
+
+  row = openGap(tree, y, at, len);
+  memcpy(&row->data[at], s, len);
+  tree->gap_x += len;
+  tree->gap_size -= len;
+  row->size += len;
+}
+
+void editorGapDelChar(EditorFile* file, int y, int at) {
+  EditorRowTree* tree = file->rows;
+  EditorRow* row = findRow(tree, y);
+  if (at < 0 || at >= row->size) return;
+
+  if (!row->plain) {
+    editorRowDelChar(file, editorGetRow(file, y), at);
+    return;
+  }
+
+  row = openGap(tree, y, at, 0);
+  tree->gap_size++;
+  row->size--;
+}
+
+// Insert
+
+// Spreads children evenly over as few inner nodes as they fit in, the first
+// one is reuse. Returns how many there are.
+static int groupNodes(RowNode** children, int count, RowInner* reuse,
+                      RowNode*** out) {
+  int n = (count + EDITOR_ROW_NODE_MAX - 1) / EDITOR_ROW_NODE_MAX;
+  RowNode** nodes = malloc_s(sizeof(RowNode*) * n);
+  int done = 0;
+  for (int i = 0; i < n; i++) {
+    RowInner* inner = (i == 0 && reuse) ? reuse : newInner();
+    int size = count / n + (i < count % n);
+    for (int j = 0; j < size; j++) {
+      inner->children[j] = children[done + j];
+      inner->sizes[j] = nodeSize(children[done + j]);
+    }
+    inner->node.count = size;
+    done += size;
+    nodes[i] = &inner->node;
+  }
+  *out = nodes;
+  return n;
+}
+
+static int nodeInsert(RowNode* node, int at, const EditorRow* rows,
+                      int count, RowNode*** out);
+
+// Returns 1 if the rows fit in the leaf, otherwise the leaf is split and
+// out gets the leaves that replace it
+static int leafInsert(RowLeaf* leaf, int at, const EditorRow* rows,
+                      int count, RowNode*** out) {
+  int old_count = leaf->node.count;
+  int total = old_count + count;
+  if (total <= EDITOR_ROW_LEAF_MAX) {
+    memmove(&leaf->rows[at + count], &leaf->rows[at],
+            sizeof(EditorRow) * (old_count - at));
+    memcpy(&leaf->rows[at], rows, sizeof(EditorRow) * count);
+    leaf->node.count = total;
+    return 1;
+  }
+
+  EditorRow* all = malloc_s(sizeof(EditorRow) * total);
+  memcpy(all, leaf->rows, sizeof(EditorRow) * at);
+  memcpy(&all[at], rows, sizeof(EditorRow) * count);
+  memcpy(&all[at + count], &leaf->rows[at],
+         sizeof(EditorRow) * (old_count - at));
+
+  int n = (total + EDITOR_ROW_LEAF_MAX - 1) / EDITOR_ROW_LEAF_MAX;
+  RowNode** nodes = malloc_s(sizeof(RowNode*) * n);
+  int done = 0;
+  for (int i = 0; i < n; i++) {
+    RowLeaf* part = i ? newLeaf() : leaf;
+    int size = total / n + (i < total % n);
+    memcpy(part->rows, &all[done], sizeof(EditorRow) * size);
+    part->node.count = size;
+    done += size;
+    nodes[i] = &part->node;
+  }
+  free(all);
+  *out = nodes;
+  return n;
+}
+
+static int innerInsert(RowInner* inner, int at, const EditorRow* rows,
+                       int count, RowNode*** out) {
+  int i = 0;
+  while (i < inner->node.count - 1 && at > inner->sizes[i]) {
+    at -= inner->sizes[i];
+    i++;
+  }
+
+  RowNode** nodes;
+  int n = nodeInsert(inner->children[i], at, rows, count, &nodes);
+  if (n == 1) {
+    inner->sizes[i] += count;
+    return 1;
+  }
+
+  // The child was split, put its parts in its place
+  int total = inner->node.count - 1 + n;
+  RowNode** children = malloc_s(sizeof(RowNode*) * total);
+  memcpy(children, inner->children, sizeof(RowNode*) * i);
+  memcpy(&children[i], nodes, sizeof(RowNode*) * n);
+  memcpy(&children[i + n], &inner->children[i + 1],
+         sizeof(RowNode*) * (inner->node.count - i - 1));
+  free(nodes);
+
+  int parts = groupNodes(children, total, inner, out);
+  free(children);
+  if (parts == 1) free(*out);
+  return parts;
+}
+
+static int nodeInsert(RowNode* node, int at, const EditorRow* rows,
+                      int count, RowNode*** out) {
+  if (node->leaf) return leafInsert((RowLeaf*)node, at, rows, count, out);
+  return innerInsert((RowInner*)node, at, rows, count, out);
+}
+
+static void treeInsert(EditorRowTree* tree, int at, const EditorRow* rows,
+                       int count) {
+  RowNode** nodes;
+  int n = nodeInsert(tree->root, at, rows, count, &nodes);
+  if (n == 1) return;
+
+  // The root was split, add levels until there's one node on top
+  while (n > 1) {
+    RowNode** parents;
+    int parent_count = groupNodes(nodes, n, NULL, &parents);
+    free(nodes);
+    nodes = parents;
+    n = parent_count;
+  }
+  tree->root = nodes[0];
+  free(nodes);
+}
+
+// Remove
+
+static bool tryMerge(RowInner* inner, int i) {
+  RowNode* a = inner->children[i];
+  RowNode* b = inner->children[i + 1];
+  int max = a->leaf ? EDITOR_ROW_LEAF_MAX : EDITOR_ROW_NODE_MAX;
+  int min = a->leaf ? ROW_LEAF_MIN : ROW_NODE_MIN;
+  if ((a->count >= min && b->count >= min) || a->count + b->count > max)
+    return false;
+
+  if (a->leaf) {
+    memcpy(&((RowLeaf*)a)->rows[a->count], ((RowLeaf*)b)->rows,
+           sizeof(EditorRow) * b->count);
+  } else {
+    RowInner* ia = (RowInner*)a;
+    RowInner* ib = (RowInner*)b;
+    memcpy(&ia->children[a->count], ib->children, sizeof(RowNode*) * b->count);
+    memcpy(&ia->sizes[a->count], ib->sizes, sizeof(int) * b->count);
+  }
+  a->count += b->count;
+  free(b);
+
+  inner->sizes[i] += inner->sizes[i + 1];
+  int after = inner->node.count - i - 2;
+  memmove(&inner->children[i + 1], &inner->children[i + 2],
+          sizeof(RowNode*) * after);
+  memmove(&inner->sizes[i + 1], &inner->sizes[i + 2], sizeof(int) * after);
+  inner->node.count--;
+  return true;
+}
+
+static void nodeRemove(RowNode* node, int at, int count) {
+  if (node->leaf) {
+    RowLeaf* leaf = (RowLeaf*)node;
+    memmove(&leaf->rows[at], &leaf->rows[at + count],
+            sizeof(EditorRow) * (node->count - at - count));
+    node->count -= count;
+    return;
+  }
+
+  // Children inside the range are dropped whole, the ones at its ends get
+  // the rest removed
+  RowInner* inner = (RowInner*)node;
+  int end = at + count;
+  int start = 0;
+  int first = -1;
+  int kept = 0;
+  for (int i = 0; i < node->count; i++) {
+    RowNode* child = inner->children[i];
+    int size = inner->sizes[i];
+    int from = (at > start) ? at : start;
+    int to = (end < start + size) ? end : start + size;
+    start += size;
+
+    if (from < to) {
+      if (first < 0) first = kept;
+      if (to - from == size) {
+        freeNode(child);
+        continue;
+      }
+      nodeRemove(child, from - (start - size), to - from);
+      size -= to - from;
+    }
+    inner->children[kept] = child;
+    inner->sizes[kept] = size;
+    kept++;
+  }
+  node->count = kept;
+
+  // Only the nodes around the range can have become too small
+  if (first < 0) return;
+  int i = (first > 0) ? first - 1 : 0;
+  while (i <= first + 1 && i + 1 < node->count) {
+    if (!tryMerge(inner, i)) i++;
+  }
+}
+
+static void treeRemove(EditorRowTree* tree, int at, int count) {
+  nodeRemove(tree->root, at, count);
+
+  RowNode* root = tree->root;
+  while (!root->leaf && root->count == 1) {
+    RowNode* child = ((RowInner*)root)->children[0];
+    free(root);
+    root = child;
+  }
+  if (!root->leaf && root->count == 0) {
+    free(root);
+    root = &newLeaf()->node;
+  }
+  tree->root = root;
+}
+
+void editorSpliceRows(EditorFile* file, int at, int remove,
+                      const EditorRow* rows, int count) {
+  EditorRowTree* tree = file->rows;
+  if (!tree) {
+    tree = calloc_s(1, sizeof(EditorRowTree));
+    tree->root = &newLeaf()->node;
+    file->rows = tree;
+  }
+  // Rows after at move
+  closeGap(tree);
+  tree->cache = NULL;
+
+  if (remove > 0) treeRemove(tree, at, remove);
+  if (count > 0) treeInsert(tree, at, rows, count);
+  file->num_rows += count - remove;
+}
+
+void editorFreeRows(EditorFile* file) {
+  EditorRowTree* tree = file->rows;
+  if (!tree) return;
+  closeGap(tree);
+  freeNodeRows(tree->root);
+  freeNode(tree->root);
+  editorFreeSlabs(&tree->slabs);
+  free(tree);
+  file->rows = NULL;
+  file->num_rows = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef ROWTREE_H
+#define ROWTREE_H
+
+#include "row.h"
+
+// Rows are kept in a B+ tree of blocks. Inner nodes know how many rows are
+// under every child, so finding, inserting and removing rows costs
+// O(log n) no matter where they are in the file.
+
+// Rows in a leaf block and children of an inner node
+#define EDITOR_ROW_LEAF_MAX 256
+#define EDITOR_ROW_NODE_MAX 64
+// Smallest gap typing opens in a row
+#define EDITOR_ROW_GAP_MIN 64
+
+typedef struct EditorRowTree EditorRowTree;
+
+// Valid until rows are inserted or removed, NULL past the last row. Rows
+// are mostly read in order, so the last block found is tried first.
+EditorRow* editorGetRow(const EditorFile* file, int y);
+
+// Typing in a row of one column characters goes through a gap kept at the
+// cursor, so a key costs the same anywhere in a long line. Other rows are
+// edited in place. editorGetRow closes the gap.
+void editorGapInsertString(EditorFile* file, int y, int at, const char* s,
+                           int len);
+void editorGapDelChar(EditorFile* file, int y, int at);
+// Closes the gap once the cursor is on another row
+void editorCloseRowGap(const EditorFile* file, int cursor_y);
+
+// The row without closing its gap. Sizes and widths can be used, the text
+// has to be read with editorCopyRowText.
+EditorRow* editorPeekRow(const EditorFile* file, int y);
+void editorCopyRowText(const EditorFile* file, int y, int at, int len,
+                       char* out);
+
+// Text of rows that aren't mapped comes from slabs freed with the rows.
+// Sizes count the '\0', data is moved when its size class changes.
+char* editorResizeRowText(const EditorFile* file, char* data,
+                          size_t old_size, size_t size);
+void editorFreeRowText(const EditorFile* file, char* data, size_t size);
+
+// Calls visit on the rows from y on until it returns false for one. Doesn't
+// touch the cache and the gap has to be closed, so another thread can walk
+// the rows while this one only reads them.
+typedef bool (*EditorRowVisit)(const EditorRow* row, void* arg);
+void editorWalkRows(const EditorRowTree* rows, int y, EditorRowVisit visit,
+                    void* arg);
+
+// Remove count rows at at and put a copy of the rows in their place. The
+// removed rows aren't freed.
+void editorSpliceRows(EditorFile* file, int at, int remove,
+                      const EditorRow* rows, int count);
+
+// Frees every row and the tree
+void editorFreeRows(EditorFile* file);
+
+#endif
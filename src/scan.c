@@ -0,0 +1,227 @@
+#include "scan.h"
+
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+#define VEC_SIZE 32
+typedef __m256i Vec;
+#define vecLoad(p) _mm256_loadu_si256((const __m256i*)(p))
+#define vecSet(c) _mm256_set1_epi8(c)
+#define vecEqMask(a, b) ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)))
+#define vecHighMask(a) ((uint32_t)_mm256_movemask_epi8(a))
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+#define VEC_SIZE 16
+typedef __m128i Vec;
+#define vecLoad(p) _mm_loadu_si128((const __m128i*)(p))
+#define vecSet(c) _mm_set1_epi8(c)
+#define vecEqMask(a, b) ((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)))
+#define vecHighMask(a) ((uint32_t)_mm_movemask_epi8(a))
+
+#endif
+
+static int scanFlags(uint8_t c) {
+  if (c >= 0x80) return LINE_NON_ASCII;
+  if (c == '\t' || c == '\0') return LINE_TAB_OR_NUL;
+  return 0;
+}
+
+// Returns a pointer to the next '\n' in [p, end), or end if there is none.
+// flags gets the LINE_* flags of the bytes before it.
+const char* scanLine(const char* p, const char* end, int* flags) {
+  int result = 0;
+
+#ifdef VEC_SIZE
+  const Vec newline = vecSet('\n');
+  const Vec tab = vecSet('\t');
+  const Vec nul = vecSet('\0');
+
+  while (end - p >= VEC_SIZE) {
+    Vec v = vecLoad(p);
+    uint32_t nl_mask = vecEqMask(v, newline);
+    uint32_t high_mask = vecHighMask(v);
+    uint32_t tab_mask = vecEqMask(v, tab) | vecEqMask(v, nul);
+
+    if (nl_mask) {
+      // Only look at the bytes before the newline
+      uint32_t before = (nl_mask & -nl_mask) - 1;
+      if (high_mask & before) result |= LINE_NON_ASCII;
+      if (tab_mask & before) result |= LINE_TAB_OR_NUL;
+      *flags = result;
+      return p + __builtin_ctz(nl_mask);
+    }
+
+    if (high_mask) result |= LINE_NON_ASCII;
+    if (tab_mask) result |= LINE_TAB_OR_NUL;
+    p += VEC_SIZE;
+  }
+#endif
+
+  while (p < end && *p != '\n') {
+    result |= scanFlags(*p);
+    p++;
+  }
+  *flags = result;
+  return p;
+}
+
+int scanText(const char* s, size_t len) {
+  const char* end = s + len;
+  int result = 0;
+
+#ifdef VEC_SIZE
+  const Vec tab = vecSet('\t');
+  const Vec nul = vecSet('\0');
+
+  while (end - s >= VEC_SIZE) {
+    Vec v = vecLoad(s);
+    if (vecHighMask(v)) result |= LINE_NON_ASCII;
+    if (vecEqMask(v, tab) | vecEqMask(v, nul)) result |= LINE_TAB_OR_NUL;
+    s += VEC_SIZE;
+  }
+#endif
+
+  while (s < end) {
+    result |= scanFlags(*s);
+    s++;
+  }
+  return result;
+}
+
+bool isValidUTF8(const char* s, size_t len) {
+  const uint8_t* p = (const uint8_t*)s;
+  const uint8_t* end = p + len;
+
+  while (p < end) {
+#ifdef VEC_SIZE
+    if (end - p >= VEC_SIZE && !vecHighMask(vecLoad(p))) {
+      p += VEC_SIZE;
+      continue;
+    }
+#endif
+
+    if (*p < 0x80) {
+      p++;
+      continue;
+    }
+
+    int bytes;
+    uint32_t unicode;
+    uint32_t min;
+    if ((*p & 0xE0) == 0xC0) {
+      unicode = *p & 0x1F;
+      bytes = 2;
+      min = 0x80;
+    } else if ((*p & 0xF0) == 0xE0) {
+      unicode = *p & 0x0F;
+      bytes = 3;
+      min = 0x800;
+    } else if ((*p & 0xF8) == 0xF0) {
+      unicode = *p & 0x07;
+      bytes = 4;
+      min = 0x10000;
+    } else {
+      return false;
+    }
+
+    if (end - p < bytes) return false;
+
+    for (int i = 1; i < bytes; i++) {
+      if ((p[i] & 0xC0) != 0x80) return false;
+      unicode = (unicode << 6) | (p[i] & 0x3F);
+    }
+
+    // Overlong encodings, surrogates and out of range code points
+    if (unicode < min || unicode > 0x10FFFF ||
+        (unicode >= 0xD800 && unicode <= 0xDFFF))
+      return false;
+
+    p += bytes;
+  }
+  return true;
+}
+
+size_t scanASCII(const char* s, size_t len) {
+  const char* p = s;
+  const char* end = s + len;
+
+#ifdef VEC_SIZE
+  while (end - p >= VEC_SIZE) {
+    uint32_t mask = vecHighMask(vecLoad(p));
+    if (mask) return p - s + __builtin_ctz(mask);
+    p += VEC_SIZE;
+  }
+#endif
+
+  while (p < end && (uint8_t)*p < 0x80) p++;
+  return p - s;
+}
+
+// UTF-16 is done 16 bytes at a time even with AVX2, whose packs don't cross
+// 128-bit lanes
+#ifdef __SSE2__
+static __m128i swapBytes16(__m128i v) {
+  return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+#endif
+
+size_t narrowUTF16(const char* in, size_t units, bool big_endian, char* out) {
+  const uint8_t* p = (const uint8_t*)in;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i high = _mm_set1_epi16((short)0xFF80);
+  const __m128i zero = _mm_setzero_si128();
+  while (units - i >= 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(p + i * 2));
+    __m128i b = _mm_loadu_si128((const __m128i*)(p + i * 2 + 16));
+    if (big_endian) {
+      a = swapBytes16(a);
+      b = swapBytes16(b);
+    }
+    __m128i bits = _mm_and_si128(_mm_or_si128(a, b), high);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(bits, zero)) != 0xFFFF) break;
+    _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(a, b));
+    i += 16;
+  }
+#endif
+
+  for (; i < units; i++) {
+    uint8_t low = p[i * 2 + big_endian];
+    uint8_t high_byte = p[i * 2 + !big_endian];
+    if (high_byte || low >= 0x80) break;
+    out[i] = low;
+  }
+  return i;
+}
+
+size_t widenASCII(const char* in, size_t len, bool big_endian, char* out) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  while (len - i >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+    if (_mm_movemask_epi8(v)) break;
+    __m128i low = _mm_unpacklo_epi8(v, zero);
+    __m128i high = _mm_unpackhi_epi8(v, zero);
+    if (big_endian) {
+      low = swapBytes16(low);
+      high = swapBytes16(high);
+    }
+    _mm_storeu_si128((__m128i*)(out + i * 2), low);
+    _mm_storeu_si128((__m128i*)(out + i * 2 + 16), high);
+    i += 16;
+  }
+#endif
+
+  for (; i < len && (uint8_t)in[i] < 0x80; i++) {
+    out[i * 2 + big_endian] = in[i];
+    out[i * 2 + !big_endian] = 0;
+  }
+  return i;
+}
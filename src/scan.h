@@ -0,0 +1,26 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Line flags
+#define LINE_NON_ASCII (1 << 0)
+// Has characters whose width isn't 1 in an ASCII line
+#define LINE_TAB_OR_NUL (1 << 1)
+
+const char* scanLine(const char* p, const char* end, int* flags);
+// LINE_* flags of every byte in s
+int scanText(const char* s, size_t len);
+bool isValidUTF8(const char* s, size_t len);
+// Length of the ASCII run at the start of s
+size_t scanASCII(const char* s, size_t len);
+
+// Converts the ASCII code units at the start of UTF-16 text to bytes and
+// returns how many there were.
+size_t narrowUTF16(const char* in, size_t units, bool big_endian, char* out);
+// Converts the ASCII bytes at the start of in to UTF-16 and returns how many
+// there were.
+size_t widenASCII(const char* in, size_t len, bool big_endian, char* out);
+
+#endif
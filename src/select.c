@@ -52,18 +52,9 @@ void editorDeleteText(EditorSelectRange range) {
   current_file->cursor.y = range.end_y;
 
   if (range.end_y - range.start_y > 1) {
-    for (int i = range.start_y + 1; i < range.end_y; i++) {
-      editorFreeRow(&current_file->row[i]);
-    }
     int removed_rows = range.end_y - range.start_y - 1;
-    memmove(&current_file->row[range.start_y + 1],
-            &current_file->row[range.end_y],
-            sizeof(EditorRow) * (current_file->num_rows - range.end_y));
-
-    current_file->num_rows -= removed_rows;
+    editorDelRows(current_file, range.start_y + 1, removed_rows);
     current_file->cursor.y -= removed_rows;
-
-    current_file->lineno_width = getDigit(current_file->num_rows) + 2;
   }
   while (current_file->cursor.y != range.start_y ||
          current_file->cursor.x != range.start_x) {
@@ -82,36 +73,50 @@ void editorCopyText(EditorClipboard* clipboard, EditorSelectRange range) {
   clipboard->data = malloc_s(sizeof(char*) * clipboard->size);
   // Only one line
   if (range.start_y == range.end_y) {
-    clipboard->data[0] = malloc_s(range.end_x - range.start_x + 1);
-    memcpy(clipboard->data[0],
-           &current_file->row[range.start_y].data[range.start_x],
-           range.end_x - range.start_x);
-    clipboard->data[0][range.end_x - range.start_x] = '\0';
+    int len = range.end_x - range.start_x;
+    clipboard->data[0] = malloc_s(len + 1);
+    // What was just typed or deleted, which can be on both sides of the gap
+    editorCopyRowText(current_file, range.start_y, range.start_x, len,
+                      clipboard->data[0]);
+    clipboard->data[0][len] = '\0';
     return;
   }
 
   // First line
-  size_t size = current_file->row[range.start_y].size - range.start_x;
+  size_t size = editorGetRow(current_file, range.start_y)->size - range.start_x;
   clipboard->data[0] = malloc_s(size + 1);
   memcpy(clipboard->data[0],
-         &current_file->row[range.start_y].data[range.start_x], size);
+         &editorGetRow(current_file, range.start_y)->data[range.start_x], size);
   clipboard->data[0][size] = '\0';
 
   // Middle
   for (int i = range.start_y + 1; i < range.end_y; i++) {
-    size = current_file->row[i].size;
+    size = editorGetRow(current_file, i)->size;
     clipboard->data[i - range.start_y] = malloc_s(size + 1);
-    memcpy(clipboard->data[i - range.start_y], current_file->row[i].data, size);
+    memcpy(clipboard->data[i - range.start_y],
+           editorGetRow(current_file, i)->data, size);
     clipboard->data[i - range.start_y][size] = '\0';
   }
   // Last line
   size = range.end_x;
   clipboard->data[range.end_y - range.start_y] = malloc_s(size + 1);
   memcpy(clipboard->data[range.end_y - range.start_y],
-         current_file->row[range.end_y].data, size);
+         editorGetRow(current_file, range.end_y)->data, size);
   clipboard->data[range.end_y - range.start_y][size] = '\0';
 }
 
+void editorCopyRows(EditorClipboard* clipboard, const EditorFile* file, int y,
+                    int count) {
+  clipboard->size = count;
+  clipboard->data = count ? malloc_s(sizeof(char*) * count) : NULL;
+  for (int i = 0; i < count; i++) {
+    const EditorRow* row = editorGetRow(file, y + i);
+    clipboard->data[i] = malloc_s(row->size + 1);
+    memcpy(clipboard->data[i], row->data, row->size);
+    clipboard->data[i][row->size] = '\0';
+  }
+}
+
 void editorPasteText(const EditorClipboard* clipboard, int x, int y) {
   if (!clipboard->size) return;
 
@@ -119,44 +124,33 @@ void editorPasteText(const EditorClipboard* clipboard, int x, int y) {
   current_file->cursor.y = y;
 
   if (clipboard->size == 1) {
-    EditorRow* row = &current_file->row[y];
+    EditorRow* row = editorGetRow(current_file, y);
     char* paste = clipboard->data[0];
     size_t paste_len = strlen(paste);
 
-    row->data = realloc_s(row->data, row->size + paste_len + 1);
-    memmove(&row->data[x + paste_len], &row->data[x], row->size - x);
-    memcpy(&row->data[x], paste, paste_len);
-    row->size += paste_len;
-    row->data[row->size] = '\0';
-    editorUpdateRow(row);
+    editorRowInsertString(current_file, row, x, paste, paste_len);
     current_file->cursor.x += paste_len;
   } else {
     // First line
     editorInsertNewline();
-    editorRowAppendString(&current_file->row[y], clipboard->data[0],
-                          strlen(clipboard->data[0]));
+    editorRowAppendString(current_file, editorGetRow(current_file, y),
+                          clipboard->data[0], strlen(clipboard->data[0]));
     // Middle
-    for (size_t i = 1; i < clipboard->size - 1; i++) {
-      editorInsertRow(current_file, y + i, clipboard->data[i],
-                      strlen(clipboard->data[i]));
-    }
+    editorInsertRows(current_file, y + 1, &clipboard->data[1],
+                     clipboard->size - 2);
     // Last line
-    EditorRow* row = &current_file->row[y + clipboard->size - 1];
+    EditorRow* row = editorGetRow(current_file, y + clipboard->size - 1);
     char* paste = clipboard->data[clipboard->size - 1];
     size_t paste_len = strlen(paste);
 
-    row->data = realloc_s(row->data, row->size + paste_len + 1);
-    memmove(&row->data[paste_len], row->data, row->size);
-    memcpy(row->data, paste, paste_len);
-    row->size += paste_len;
-    row->data[row->size] = '\0';
-    editorUpdateRow(row);
+    editorRowInsertString(current_file, row, 0, paste, paste_len);
 
     current_file->cursor.y = y + clipboard->size - 1;
     current_file->cursor.x = paste_len;
   }
-  current_file->sx = editorRowCxToRx(&current_file->row[current_file->cursor.y],
-                                     current_file->cursor.x);
+  current_file->sx =
+      editorRowCxToRx(editorGetRow(current_file, current_file->cursor.y),
+                      current_file->cursor.x);
 }
 
 void editorFreeClipboardContent(EditorClipboard* clipboard) {
@@ -168,6 +162,45 @@ void editorFreeClipboardContent(EditorClipboard* clipboard) {
   free(clipboard->data);
 }
 
+void abufAppendClipboard(abuf* ab, const EditorClipboard* clipboard) {
+  abufAppendVarint(ab, clipboard->size);
+  for (size_t i = 0; i < clipboard->size; i++) {
+    size_t len = strlen(clipboard->data[i]);
+    abufAppendVarint(ab, len);
+    abufAppendN(ab, clipboard->data[i], len);
+  }
+}
+
+bool readClipboard(const char** p, const char* end,
+                   EditorClipboard* clipboard) {
+  uint64_t count;
+  // Every line takes at least a byte
+  if (!readVarint(p, end, &count) || count > (uint64_t)(end - *p))
+    return false;
+
+  clipboard->size = 0;
+  clipboard->data = count ? malloc_s(sizeof(char*) * count) : NULL;
+  for (uint64_t i = 0; i < count; i++) {
+    uint64_t len;
+    if (!readVarint(p, end, &len) || len > (uint64_t)(end - *p) ||
+        memchr(*p, '\0', len)) {
+      for (size_t j = 0; j < clipboard->size; j++) {
+        free(clipboard->data[j]);
+      }
+      free(clipboard->data);
+      clipboard->size = 0;
+      clipboard->data = NULL;
+      return false;
+    }
+    clipboard->data[i] = malloc_s(len + 1);
+    memcpy(clipboard->data[i], *p, len);
+    clipboard->data[i][len] = '\0';
+    clipboard->size++;
+    *p += len;
+  }
+  return true;
+}
+
 void editorCopyToSysClipboard(EditorClipboard* clipboard) {
   if (!clipboard || !clipboard->size) return;
 
@@ -4,6 +4,10 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "utils.h"
+
+typedef struct EditorFile EditorFile;
+
 typedef struct EditorClipboard {
   size_t size;
   char** data;
@@ -21,10 +25,17 @@ bool isPosSelected(int row, int col, EditorSelectRange range);
 
 void editorDeleteText(EditorSelectRange range);
 void editorCopyText(EditorClipboard* clipboard, EditorSelectRange range);
+// Whole rows of a file, without the newlines around them
+void editorCopyRows(EditorClipboard* clipboard, const EditorFile* file, int y,
+                    int count);
 void editorPasteText(const EditorClipboard* clipboard, int x, int y);
 
 void editorFreeClipboardContent(EditorClipboard* clipboard);
 
+// Varint encoded lines, for the files changes are kept in
+void abufAppendClipboard(abuf* ab, const EditorClipboard* clipboard);
+bool readClipboard(const char** p, const char* end, EditorClipboard* clipboard);
+
 void editorCopyToSysClipboard(EditorClipboard* clipboard);
 
 #endif
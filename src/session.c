@@ -0,0 +1,300 @@
+#include "session.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "editor.h"
+#include "os.h"
+#include "prompt.h"
+#include "utils.h"
+
+#define SESSION_MAGIC "NINOSES\x02"
+#define SESSION_MAGIC_SIZE 8
+
+#define SESSION_TAB_VIEW (1 << 0)
+
+// Where a tab was left. Line is counted from the file start, so it stays
+// right for view mode where the rows are only a window of the file.
+struct EditorSessionTab {
+  bool loaded;
+  bool view;
+  FileStamp stamp;
+  uint8_t newline;
+
+  int64_t line;
+  int x;
+  int screen_y;
+  int col_offset;
+};
+
+static bool sessionPath(char* path) {
+  return getConfigPath(path, "session", "tabs");
+}
+
+static void sessionAppendTab(abuf* ab, const char* filename,
+                             const EditorSessionTab* tab) {
+  size_t len = strlen(filename);
+  abufAppendVarint(ab, len);
+  abufAppendN(ab, filename, len);
+  abufAppendVarint(ab, tab->view ? SESSION_TAB_VIEW : 0);
+  abufAppendVarint(ab, tab->stamp.id);
+  abufAppendVarint(ab, (uint64_t)tab->stamp.size);
+  abufAppendVarint(ab, (uint64_t)tab->stamp.mtime);
+  abufAppendVarint(ab, tab->newline);
+  abufAppendVarint(ab, (uint64_t)tab->line);
+  abufAppendVarint(ab, tab->x);
+  abufAppendVarint(ab, tab->screen_y);
+  abufAppendVarint(ab, tab->col_offset);
+}
+
+static EditorSessionTab sessionGetTab(EditorFile* file) {
+  EditorSessionTab tab = {0};
+  tab.view = (file->pager != NULL);
+  tab.stamp = getFileStamp(file->file_info);
+  tab.newline = file->newline;
+
+  int64_t line = editorGetLineNumber(file, file->cursor.y);
+  if (line > 0) {
+    tab.line = line - 1;
+    tab.x = file->cursor.x;
+    tab.screen_y = file->cursor.y - file->row_offset;
+    tab.col_offset = file->col_offset;
+  }
+  return tab;
+}
+
+void editorSaveSession(void) {
+  char path[EDITOR_PATH_MAX];
+  if (!sessionPath(path)) return;
+
+  int count = 0;
+  int current = 0;
+  abuf tabs = ABUF_INIT;
+  for (int i = 0; i < editor.file_count; i++) {
+    EditorFile* file = &editor.files[i];
+    if (!file->filename) continue;
+    if (i == editor.file_index) current = count;
+
+    // Tabs that were never shown or haven't moved there yet are kept as is
+    if (file->session) {
+      sessionAppendTab(&tabs, file->filename, file->session);
+    } else {
+      EditorSessionTab tab = sessionGetTab(file);
+      sessionAppendTab(&tabs, file->filename, &tab);
+    }
+    count++;
+  }
+
+  if (!count) {
+    abufFree(&tabs);
+    remove(path);
+    return;
+  }
+
+  abuf ab = ABUF_INIT;
+  abufAppendN(&ab, SESSION_MAGIC, SESSION_MAGIC_SIZE);
+  abufAppendVarint(&ab, count);
+  abufAppendVarint(&ab, current);
+  abufAppendN(&ab, tabs.buf, tabs.len);
+  abufFree(&tabs);
+
+  // Written next to the old one, so a crash never leaves half a session
+  char temp_path[EDITOR_PATH_MAX];
+  FILE* fp = openTempFile(path, temp_path);
+  if (fp) {
+    bool success = fwrite(ab.buf, 1, ab.len, fp) == ab.len;
+    success = (fclose(fp) == 0) && success;
+    if (!success || !replaceFile(temp_path, path)) remove(temp_path);
+  }
+  abufFree(&ab);
+}
+
+static bool readInt(const char** p, const char* end, int* n) {
+  uint64_t value;
+  if (!readVarint(p, end, &value) || value > INT32_MAX) return false;
+  *n = value;
+  return true;
+}
+
+static bool sessionReadTab(const char** p, const char* end, char* filename,
+                           EditorSessionTab* tab) {
+  uint64_t len, flags, size, mtime, newline, line;
+  if (!readVarint(p, end, &len) || len == 0 || len >= EDITOR_PATH_MAX ||
+      len > (uint64_t)(end - *p))
+    return false;
+  memcpy(filename, *p, len);
+  filename[len] = '\0';
+  *p += len;
+
+  if (!readVarint(p, end, &flags) || !readVarint(p, end, &tab->stamp.id) ||
+      !readVarint(p, end, &size) || !readVarint(p, end, &mtime) ||
+      !readVarint(p, end, &newline) || !readVarint(p, end, &line) ||
+      !readInt(p, end, &tab->x) || !readInt(p, end, &tab->screen_y) ||
+      !readInt(p, end, &tab->col_offset))
+    return false;
+  if (newline != NL_UNIX && newline != NL_DOS) return false;
+  if (line > INT64_MAX || size > INT64_MAX) return false;
+
+  tab->view = flags & SESSION_TAB_VIEW;
+  tab->stamp.size = size;
+  tab->stamp.mtime = mtime;
+  tab->newline = newline;
+  tab->line = line;
+  return true;
+}
+
+static bool isTabOpened(FileInfo info) {
+  for (int i = 0; i < editor.file_count; i++) {
+    if (areFilesEqual(editor.files[i].file_info, info)) return true;
+  }
+  return false;
+}
+
+bool editorRestoreSession(void) {
+  char path[EDITOR_PATH_MAX];
+  if (!sessionPath(path)) return false;
+  FILE* fp = openFile(path, "rb");
+  if (!fp) return false;
+
+  abuf ab = ABUF_INIT;
+  char buf[1 << 16];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    abufAppendN(&ab, buf, n);
+  }
+  fclose(fp);
+
+  const char* p = ab.buf;
+  const char* end = ab.buf + ab.len;
+  int count, current;
+  if (end - p < SESSION_MAGIC_SIZE ||
+      memcmp(p, SESSION_MAGIC, SESSION_MAGIC_SIZE) != 0) {
+    abufFree(&ab);
+    return false;
+  }
+  p += SESSION_MAGIC_SIZE;
+  if (!readInt(&p, end, &count) || !readInt(&p, end, &current)) {
+    abufFree(&ab);
+    return false;
+  }
+
+  // Only the file names are checked here, nothing is read until a tab is
+  // shown
+  int first = editor.file_count;
+  int index = -1;
+  char filename[EDITOR_PATH_MAX];
+  for (int i = 0; i < count && editor.file_count < EDITOR_FILE_MAX_SLOT;
+       i++) {
+    EditorSessionTab* tab = calloc_s(1, sizeof(EditorSessionTab));
+    if (!sessionReadTab(&p, end, filename, tab)) {
+      free(tab);
+      break;
+    }
+
+    FileInfo info = getFileInfo(filename);
+    if (getFileType(filename) != FT_REG || info.error || isTabOpened(info)) {
+      free(tab);
+      continue;
+    }
+
+    EditorFile file;
+    editorInitFile(&file);
+    size_t len = strlen(filename) + 1;
+    file.filename = malloc_s(len);
+    memcpy(file.filename, filename, len);
+    file.file_info = info;
+    file.newline = tab->newline;
+    file.session = tab;
+    int added = editorAddFile(&file);
+    if (i <= current) index = added;
+  }
+  abufFree(&ab);
+
+  if (editor.file_count == first) return false;
+  editorChangeToFile(index < 0 ? first : index);
+  return true;
+}
+
+void editorLoadTab(EditorFile* file) {
+  EditorSessionTab* tab = file->session;
+  if (!tab || tab->loaded) return;
+
+  // Not found as already open while it's being opened
+  file->file_info.error = true;
+
+  EditorFile loaded;
+  bool opened = tab->view ? editorOpenView(&loaded, file->filename)
+                          : editorOpen(&loaded, file->filename);
+  if (!opened) {
+    // Keep the tab as an empty buffer, the reason is in the message
+    editorInitFile(&loaded);
+    editorInsertRow(&loaded, 0, "", 0);
+    loaded.filename = file->filename;
+    loaded.file_info = getFileInfo(file->filename);
+    file->filename = NULL;
+  }
+
+  free(file->filename);
+  loaded.action_head = file->action_head;
+  loaded.action_current = file->action_current;
+  loaded.session = tab;
+  *file = loaded;
+  tab->loaded = true;
+
+  if (areStampsEqual(tab->stamp, getFileStamp(file->file_info))) {
+    file->newline = tab->newline;
+  }
+
+  // Files loading in the background are recovered once they are loaded
+  if (!file->loader) {
+    editorLoadHistory(file);
+    editorRecoverJournal(file);
+  }
+  editorPollSession(file);
+}
+
+bool editorPollSession(EditorFile* file) {
+  EditorSessionTab* tab = file->session;
+  if (!tab || !tab->loaded) return false;
+
+  // Wait for the background load to get there
+  if (file->loader && tab->line >= file->num_rows) return false;
+
+  // Recovered changes already moved the cursor
+  if (file->dirty) {
+    editorFreeSessionTab(file);
+    return false;
+  }
+
+  if (file->pager) {
+    if (tab->line > 0 && !editorPagerGoto(file, tab->line)) {
+      editorFreeSessionTab(file);
+      return false;
+    }
+  } else {
+    file->cursor.y = (tab->line < file->num_rows) ? tab->line
+                                                   : file->num_rows - 1;
+  }
+
+  EditorRow* row = editorGetRow(file, file->cursor.y);
+  file->cursor.x = (tab->x < row->size) ? tab->x : row->size;
+  file->cursor.is_selected = false;
+  file->cursor.select_x = file->cursor.x;
+  file->cursor.select_y = file->cursor.y;
+  file->sx = editorRowCxToRx(row, file->cursor.x);
+
+  int screen_y = tab->screen_y;
+  if (screen_y >= editor.display_rows) screen_y = editor.display_rows - 1;
+  file->row_offset = file->cursor.y - screen_y;
+  if (file->row_offset < 0) file->row_offset = 0;
+  file->col_offset = (tab->col_offset <= file->sx) ? tab->col_offset : 0;
+
+  editorFreeSessionTab(file);
+  return true;
+}
+
+void editorFreeSessionTab(EditorFile* file) {
+  free(file->session);
+  file->session = NULL;
+}
@@ -0,0 +1,20 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdbool.h>
+
+typedef struct EditorFile EditorFile;
+typedef struct EditorSessionTab EditorSessionTab;
+
+// The open tabs are written to a file under CONF_DIR on quit and reopened
+// when nino starts without files. Restored tabs are only loaded when they
+// are first shown.
+void editorSaveSession(void);
+bool editorRestoreSession(void);
+
+void editorLoadTab(EditorFile* file);
+// Move the cursor back once the rows it was on are loaded
+bool editorPollSession(EditorFile* file);
+void editorFreeSessionTab(EditorFile* file);
+
+#endif
@@ -0,0 +1,106 @@
+#include "slab.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+struct EditorSlab {
+  EditorSlab* next;
+  size_t used;
+  char data[];
+};
+
+struct EditorSlabBlock {
+  EditorSlabBlock* next;
+};
+
+// Two classes for every power of two, so a block wastes at most a third
+static const size_t slab_sizes[EDITOR_SLAB_CLASSES] = {
+    16,  24,  32,  48,   64,   96,   128,  192, 256,
+    384, 512, 768, 1024, 1536, 2048, 3072, 4096,
+};
+
+static int slabClass(size_t size) {
+  int i = 0;
+  while (slab_sizes[i] < size) i++;
+  return i;
+}
+
+static void slabPush(EditorSlabs* slabs, int c, char* p) {
+  EditorSlabBlock* block = (EditorSlabBlock*)p;
+  block->next = slabs->free[c];
+  slabs->free[c] = block;
+}
+
+static void slabNew(EditorSlabs* slabs) {
+  EditorSlab* head = slabs->head;
+  // What's left of the old slab still gets used by smaller classes
+  if (head) {
+    for (int c = EDITOR_SLAB_CLASSES - 1; c >= 0; c--) {
+      while (EDITOR_SLAB_SIZE - head->used >= slab_sizes[c]) {
+        slabPush(slabs, c, &head->data[head->used]);
+        head->used += slab_sizes[c];
+      }
+    }
+  }
+
+  EditorSlab* slab = malloc_s(sizeof(EditorSlab) + EDITOR_SLAB_SIZE);
+  slab->next = head;
+  slab->used = 0;
+  slabs->head = slab;
+}
+
+char* editorSlabAlloc(EditorSlabs* slabs, size_t size) {
+  if (size > EDITOR_SLAB_MAX) return malloc_s(size);
+
+  int c = slabClass(size);
+  EditorSlabBlock* block = slabs->free[c];
+  if (block) {
+    slabs->free[c] = block->next;
+    return (char*)block;
+  }
+
+  if (!slabs->head || EDITOR_SLAB_SIZE - slabs->head->used < slab_sizes[c]) {
+    slabNew(slabs);
+  }
+  char* p = &slabs->head->data[slabs->head->used];
+  slabs->head->used += slab_sizes[c];
+  return p;
+}
+
+char* editorSlabRealloc(EditorSlabs* slabs, char* p, size_t old_size,
+                        size_t size) {
+  if (!p) return editorSlabAlloc(slabs, size);
+  if (old_size > EDITOR_SLAB_MAX && size > EDITOR_SLAB_MAX) {
+    return realloc_s(p, size);
+  }
+  if (old_size <= EDITOR_SLAB_MAX && size <= EDITOR_SLAB_MAX &&
+      slabClass(old_size) == slabClass(size)) {
+    return p;
+  }
+
+  char* data = editorSlabAlloc(slabs, size);
+  memcpy(data, p, old_size < size ? old_size : size);
+  editorSlabFree(slabs, p, old_size);
+  return data;
+}
+
+void editorSlabFree(EditorSlabs* slabs, char* p, size_t size) {
+  if (!p) return;
+  if (size > EDITOR_SLAB_MAX) {
+    free(p);
+    return;
+  }
+  slabPush(slabs, slabClass(size), p);
+}
+
+void editorFreeSlabs(EditorSlabs* slabs) {
+  EditorSlab* slab = slabs->head;
+  while (slab) {
+    EditorSlab* next = slab->next;
+    free(slab);
+    slab = next;
+  }
+  memset(slabs, 0, sizeof(EditorSlabs));
+}
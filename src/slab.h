@@ -0,0 +1,34 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// Text of edited rows comes in size classes carved out of large slabs. A
+// freed block goes on the free list of its class and the slabs are freed
+// all at once with the rows, so editing doesn't go through malloc for every
+// row. A block holds its whole class, callers pass the size they asked for
+// when they resize or free it.
+
+#define EDITOR_SLAB_SIZE (64 << 10)
+// Bigger blocks come from malloc
+#define EDITOR_SLAB_MAX 4096
+// 16, 24, 32, 48, 64, ... up to EDITOR_SLAB_MAX
+#define EDITOR_SLAB_CLASSES 17
+
+typedef struct EditorSlab EditorSlab;
+typedef struct EditorSlabBlock EditorSlabBlock;
+
+typedef struct EditorSlabs {
+  // The slab being carved is first
+  EditorSlab* head;
+  EditorSlabBlock* free[EDITOR_SLAB_CLASSES];
+} EditorSlabs;
+
+char* editorSlabAlloc(EditorSlabs* slabs, size_t size);
+// Stays in place while the size is in the same class
+char* editorSlabRealloc(EditorSlabs* slabs, char* p, size_t old_size,
+                        size_t size);
+void editorSlabFree(EditorSlabs* slabs, char* p, size_t size);
+void editorFreeSlabs(EditorSlabs* slabs);
+
+#endif
@@ -17,6 +17,9 @@
 #include "os.h"
 #include "output.h"
 
+// Background work is checked at least this often (ms)
+#define POLL_INTERVAL 100
+
 static struct termios orig_termios;
 
 static void disableRawMode(void) {
@@ -171,7 +174,9 @@ EditorInput editorReadKey(void) {
   uint32_t c;
   EditorInput result = {.type = UNKNOWN};
 
-  while (!readConsole(&c)) {
+  // Background workers wake this up when they finish
+  while (!waitForInput(POLL_INTERVAL) || !readConsole(&c)) {
+    if (editorPollBackground()) editorRefreshScreen();
   }
 
   if (c == ESC) {
@@ -307,6 +312,18 @@ static void SIGABRT_handler(int sig) {
   _exit(EXIT_FAILURE);
 }
 
+// A mapped file was truncated by another program. What was past its new end
+// reads as zeros and the editor keeps running, the rows are copied out of
+// the mapping once the main loop notices.
+static void SIGBUS_handler(int sig, siginfo_t* info, void* context) {
+  UNUSED(context);
+  if (sig != SIGBUS) return;
+  if (info->si_code == BUS_ADRERR && mapZeroPage(info->si_addr)) return;
+  terminalExit();
+  UNUSED(write(STDOUT_FILENO, "Exit from SIGBUS_handler\r\n", 26));
+  _exit(EXIT_FAILURE);
+}
+
 static void enableSwap(void) {
   UNUSED(write(STDOUT_FILENO, "\x1b[?1049h\x1b[H", 11));
 }
@@ -357,6 +374,14 @@ void editorInitTerminal(void) {
   if (signal(SIGABRT, SIGABRT_handler) == SIG_ERR) {
     PANIC("SIGABRT_handler");
   }
+
+  struct sigaction bus = {0};
+  bus.sa_sigaction = SIGBUS_handler;
+  bus.sa_flags = SA_SIGINFO;
+  sigemptyset(&bus.sa_mask);
+  if (sigaction(SIGBUS, &bus, NULL) == -1) {
+    PANIC("SIGBUS_handler");
+  }
 }
 
 void terminalExit(void) {
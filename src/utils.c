@@ -200,7 +200,7 @@ int64_t getLine(char **lineptr, size_t *n, FILE *stream) {
 
   while (c != EOF) {
     if ((size_t)size > (capacity - 1)) {
-      capacity += buf_size;
+      capacity *= 2;
       buf = realloc_s(buf, capacity);
     }
     buf[size++] = c;
@@ -229,14 +229,16 @@ int strCaseCmp(const char *s1, const char *s2) {
   return result;
 }
 
-char *strCaseStr(const char *str, const char *sub_str) {
+// str doesn't need to be null-terminated
+char *strCaseStr(const char *str, size_t len, const char *sub_str) {
   // O(n*m), but should be ok
   if (*sub_str == '\0') return (char *)str;
 
-  while (*str != '\0') {
+  const char *end = str + len;
+  while (str < end) {
     const char *s = str;
     const char *sub = sub_str;
-    while (tolower(*s) == tolower(*sub)) {
+    while (s < end && tolower(*s) == tolower(*sub)) {
       s++;
       sub++;
       if (*sub == '\0') {
@@ -249,6 +251,30 @@ char *strCaseStr(const char *str, const char *sub_str) {
   return NULL;
 }
 
+// Searching backward is done in chunks this big
+#define FIND_BACKWARD_CHUNK (1 << 20)
+
+char *strCaseStrBefore(const char *start, const char *p, const char *end,
+                       const char *sub_str) {
+  size_t len = strlen(sub_str);
+  while (p > start) {
+    const char *chunk =
+        (p - start > FIND_BACKWARD_CHUNK) ? p - FIND_BACKWARD_CHUNK : start;
+    const char *limit = ((size_t)(end - p) > len) ? p + len - 1 : end;
+
+    const char *last = NULL;
+    const char *s = chunk;
+    const char *match;
+    while ((match = strCaseStr(s, limit - s, sub_str)) != NULL && match < p) {
+      last = match;
+      s = match + 1;
+    }
+    if (last) return (char *)last;
+    p = chunk;
+  }
+  return NULL;
+}
+
 int strToInt(const char *str) {
   if (!str) {
     return 0;
@@ -289,6 +315,51 @@ int strToInt(const char *str) {
   return result;
 }
 
+uint64_t hashString(const char *str) {
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325;
+  while (*str) {
+    hash ^= (uint8_t)*str++;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+uint64_t hashBytes(const char *data, size_t len) {
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (uint8_t)data[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+void abufAppendVarint(abuf *ab, uint64_t n) {
+  char buf[10];
+  size_t len = 0;
+  do {
+    buf[len] = n & 0x7F;
+    n >>= 7;
+    if (n) buf[len] |= 0x80;
+    len++;
+  } while (n);
+  abufAppendN(ab, buf, len);
+}
+
+bool readVarint(const char **p, const char *end, uint64_t *n) {
+  uint64_t result = 0;
+  for (int shift = 0; *p < end && shift < 64; shift += 7) {
+    uint8_t byte = *(*p)++;
+    result |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *n = result;
+      return true;
+    }
+  }
+  return false;
+}
+
 // https://opensource.apple.com/source/QuickTimeStreamingServer/QuickTimeStreamingServer-452/CommonUtilitiesLib/base64.c
 
 static const char basis_64[] =
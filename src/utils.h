@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -117,8 +118,18 @@ int getDigit(int n);
 // String
 int64_t getLine(char** lineptr, size_t* n, FILE* stream);
 int strCaseCmp(const char* s1, const char* s2);
-char* strCaseStr(const char* str, const char* sub_str);
+char* strCaseStr(const char* str, size_t len, const char* sub_str);
+// Last match that starts before p, it can run on up to end
+char* strCaseStrBefore(const char* start, const char* p, const char* end,
+                       const char* sub_str);
 int strToInt(const char* str);
+uint64_t hashString(const char* str);
+uint64_t hashBytes(const char* data, size_t len);
+
+// Binary encoding
+void abufAppendVarint(abuf* ab, uint64_t n);
+// Returns false if the number doesn't end before end
+bool readVarint(const char** p, const char* end, uint64_t* n);
 
 // Base64
 static inline int base64EncodeLen(int len) { return ((len + 2) / 3 * 4) + 1; }